@@ -0,0 +1,113 @@
+// dcache.cc 
+//	Routines to manage the cache of directory entries.
+//
+//	Each translation can only live in the slot selected by hashing
+//	its directory and file name, so there is nothing to search,
+//	and nothing to replace but the translation already in the slot.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "utility.h"
+#include "dcache.h"
+
+//----------------------------------------------------------------------
+// DentryCache::DentryCache
+// 	Initialize an empty cache.
+//
+//	"size" is the number of translations to cache
+//----------------------------------------------------------------------
+
+DentryCache::DentryCache(int size)
+{
+    table = new DentryCacheEntry[size];
+    tableSize = size;
+    for (int i = 0; i < tableSize; i++)
+	table[i].valid = FALSE;
+}
+
+//----------------------------------------------------------------------
+// DentryCache::~DentryCache
+// 	De-allocate the cache.
+//----------------------------------------------------------------------
+
+DentryCache::~DentryCache()
+{
+    delete [] table;
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Slot
+// 	Return the slot of the table for "name" in the directory whose
+//	header is at "dirSector".  Only the part of the name that a
+//	directory stores is hashed.
+//----------------------------------------------------------------------
+
+DentryCacheEntry *
+DentryCache::Slot(int dirSector, char *name)
+{
+    unsigned int hash = dirSector;
+
+    for (int i = 0; (i < FileNameMaxLen) && (name[i] != '\0'); i++)
+	hash = hash * 31 + (unsigned char) name[i];
+    return &table[hash % tableSize];
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Lookup
+// 	Return the sector of the file header of "name" in the directory
+//	whose header is at "dirSector", or -1 if that isn't cached.
+//	Set "*isDir" to whether the file is a directory.
+//----------------------------------------------------------------------
+
+int
+DentryCache::Lookup(int dirSector, char *name, bool *isDir)
+{
+    DentryCacheEntry *entry = Slot(dirSector, name);
+
+    if (entry->valid && (entry->dirSector == dirSector)
+	    && !strncmp(entry->name, name, FileNameMaxLen)) {
+	DEBUG('f', "Dentry cache hit for %s\n", name);
+	*isDir = entry->isDir;
+	return entry->sector;
+    }
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Enter
+// 	Remember that the file header of "name", in the directory whose
+//	header is at "dirSector", is at "sector", and whether it is a
+//	directory.
+//----------------------------------------------------------------------
+
+void
+DentryCache::Enter(int dirSector, char *name, int sector, bool isDir)
+{
+    DentryCacheEntry *entry = Slot(dirSector, name);
+
+    entry->valid = TRUE;
+    entry->dirSector = dirSector;
+    entry->sector = sector;
+    entry->isDir = isDir;
+    strncpy(entry->name, name, FileNameMaxLen);
+    entry->name[FileNameMaxLen] = '\0';
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Remove
+// 	Forget the translation for "name" in the directory whose header
+//	is at "dirSector", if it is cached.
+//----------------------------------------------------------------------
+
+void
+DentryCache::Remove(int dirSector, char *name)
+{
+    DentryCacheEntry *entry = Slot(dirSector, name);
+
+    if (entry->valid && (entry->dirSector == dirSector)
+	    && !strncmp(entry->name, name, FileNameMaxLen))
+	entry->valid = FALSE;
+}
@@ -0,0 +1,63 @@
+// dcache.h 
+//	Data structures for the directory entry ("dentry") cache.
+//
+//	The dentry cache remembers recent <directory, file name> ->
+//	file header sector translations, so that opening a file
+//	that was opened recently does not have to read the directory
+//	from disk and search it.  Walking a path looks up each
+//	component here in turn, so a deep path that was used recently
+//	resolves without reading any of the directories on the way.
+//
+//	The cache is only a hint about what is on disk; the file system
+//	must keep it up to date as files are created and removed.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef DCACHE_H
+#define DCACHE_H
+
+#include "directory.h"
+
+#define DentryCacheSize		64	// number of cached translations
+
+// One cached translation.
+
+class DentryCacheEntry {
+  public:
+    bool valid;				// Is this entry in use?
+    int dirSector;			// Header sector of the directory
+    int sector;				// Header sector of the file
+    bool isDir;				// Is the file a directory?
+    char name[FileNameMaxLen + 1];	// Name of the file in the directory
+};
+
+// The following class defines the dentry cache.  It is a hash table
+// indexed by directory and name, with one translation per slot;
+// a new translation simply replaces whatever was in its slot.
+
+class DentryCache {
+  public:
+    DentryCache(int size);		// Initialize an empty cache
+    ~DentryCache();
+
+    int Lookup(int dirSector, char *name, bool *isDir);
+					// Return the file header sector of
+					// "name", or -1 if it isn't cached
+    void Enter(int dirSector, char *name, int sector, bool isDir);
+					// Remember a translation
+    void Remove(int dirSector, char *name);
+					// Forget a translation
+
+  private:
+    DentryCacheEntry *table;		// The cached translations
+    int tableSize;
+
+    DentryCacheEntry *Slot(int dirSector, char *name);
+					// Where a translation would be kept
+};
+
+#endif // DCACHE_H
@@ -2,8 +2,9 @@
 //	Routines to manage a directory of file names.
 //
 //	The directory is a table of fixed length entries; each
-//	entry represents a single file, and contains the file name,
-//	and the location of the file header on disk.  The fixed size
+//	entry represents a single file or subdirectory, and contains
+//	the file name, and the location of the file header on disk.
+//	A subdirectory is just a file holding another directory.  The fixed size
 //	of each directory entry means that we have the restriction
 //	of a fixed maximum size for file names.
 //
@@ -11,10 +12,9 @@
 //	we use ReadFrom/WriteBack to fetch the contents of the directory
 //	from disk, and to write back any modifications back to disk.
 //
-//	Also, this implementation has the restriction that the size
-//	of the directory cannot expand.  In other words, once all the
-//	entries in the directory are used, no more files can be created.
-//	Fixing this is one of the parts to the assignment.
+//	The entries form a hash table with linear probing.  The table
+//	itself cannot expand; instead, when it is full, the file system
+//	builds a bigger directory and moves the entries over with Rehash.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -39,8 +39,13 @@ Directory::Directory(int size)
 {
     table = new DirectoryEntry[size];
     tableSize = size;
+    numEntries = 0;
     for (int i = 0; i < tableSize; i++)
 	table[i].inUse = FALSE;
+    numSectors = divRoundUp(size * sizeof(DirectoryEntry), SectorSize);
+    dirty = new bool[numSectors];
+    for (int i = 0; i < numSectors; i++)
+	dirty[i] = TRUE;		// nothing on disk yet
 }
 
 //----------------------------------------------------------------------
@@ -51,6 +56,7 @@ Directory::Directory(int size)
 Directory::~Directory()
 { 
     delete [] table;
+    delete [] dirty;
 } 
 
 //----------------------------------------------------------------------
@@ -64,6 +70,12 @@ void
 Directory::FetchFrom(OpenFile *file)
 {
     (void) file->ReadAt((char *)table, tableSize * sizeof(DirectoryEntry), 0);
+    numEntries = 0;
+    for (int i = 0; i < tableSize; i++)
+	if (table[i].inUse)
+	    numEntries++;
+    for (int i = 0; i < numSectors; i++)
+	dirty[i] = FALSE;
 }
 
 //----------------------------------------------------------------------
@@ -77,6 +89,65 @@ void
 Directory::WriteBack(OpenFile *file)
 {
     (void) file->WriteAt((char *)table, tableSize * sizeof(DirectoryEntry), 0);
+    for (int i = 0; i < numSectors; i++)
+	dirty[i] = FALSE;
+}
+
+//----------------------------------------------------------------------
+// Directory::Flush
+// 	Write the sectors of the directory file holding entries that were
+//	changed since the directory was last read or written back.
+//
+//	"file" -- file to contain the new directory contents
+//----------------------------------------------------------------------
+
+void
+Directory::Flush(OpenFile *file)
+{
+    int size = tableSize * sizeof(DirectoryEntry);
+    int start, length;
+
+    for (int i = 0; i < numSectors; i++) {
+	if (!dirty[i])
+	    continue;
+	start = i * SectorSize;
+	length = min(SectorSize, size - start);
+	(void) file->WriteAt((char *)table + start, length, start);
+	dirty[i] = FALSE;
+    }
+}
+
+//----------------------------------------------------------------------
+// Directory::MarkDirty
+// 	Note that the sectors holding entry "index" need writing back.
+//----------------------------------------------------------------------
+
+void
+Directory::MarkDirty(int index)
+{
+    int start = index * sizeof(DirectoryEntry);
+    int end = start + sizeof(DirectoryEntry) - 1;
+
+    for (int i = start / SectorSize; i <= end / SectorSize; i++)
+	dirty[i] = TRUE;
+}
+
+//----------------------------------------------------------------------
+// Directory::Hash
+// 	Return the slot of the table where the search for "name" starts.
+//	Only the part of the name that is stored is hashed.
+//
+//	"name" -- the file name to look up
+//----------------------------------------------------------------------
+
+int
+Directory::Hash(char *name)
+{
+    unsigned int hash = 5381;
+
+    for (int i = 0; (i < FileNameMaxLen) && (name[i] != '\0'); i++)
+	hash = hash * 33 + (unsigned char) name[i];
+    return hash % tableSize;
 }
 
 //----------------------------------------------------------------------
@@ -90,9 +161,13 @@ Directory::WriteBack(OpenFile *file)
 int
 Directory::FindIndex(char *name)
 {
-    for (int i = 0; i < tableSize; i++)
-        if (table[i].inUse && !strncmp(table[i].name, name, FileNameMaxLen))
+    int i = Hash(name);
+
+    for (int n = 0; (n < tableSize) && table[i].inUse; n++) {
+        if (!strncmp(table[i].name, name, FileNameMaxLen))
 	    return i;
+	i = (i + 1) % tableSize;
+    }
     return -1;		// name not in directory
 }
 
@@ -115,6 +190,21 @@ Directory::Find(char *name)
     return -1;
 }
 
+//----------------------------------------------------------------------
+// Directory::IsDirectory
+// 	Return TRUE if "name" is in the directory and is a subdirectory.
+//
+//	"name" -- the file name to look up
+//----------------------------------------------------------------------
+
+bool
+Directory::IsDirectory(char *name)
+{
+    int i = FindIndex(name);
+
+    return (i != -1) && table[i].isDir;
+}
+
 //----------------------------------------------------------------------
 // Directory::Add
 // 	Add a file into the directory.  Return TRUE if successful;
@@ -124,22 +214,27 @@ Directory::Find(char *name)
 //
 //	"name" -- the name of the file being added
 //	"newSector" -- the disk sector containing the added file's header
+//	"isDir" -- is the file a subdirectory?
 //----------------------------------------------------------------------
 
 bool
-Directory::Add(char *name, int newSector)
+Directory::Add(char *name, int newSector, bool isDir)
 { 
-    if (FindIndex(name) != -1)
+    int i;
+
+    if (IsFull() || (FindIndex(name) != -1))
 	return FALSE;
 
-    for (int i = 0; i < tableSize; i++)
-        if (!table[i].inUse) {
-            table[i].inUse = TRUE;
-            strncpy(table[i].name, name, FileNameMaxLen); 
-            table[i].sector = newSector;
-        return TRUE;
-	}
-    return FALSE;	// no space.  Fix when we have extensible files.
+    for (i = Hash(name); table[i].inUse; i = (i + 1) % tableSize)
+	;
+    table[i].inUse = TRUE;
+    strncpy(table[i].name, name, FileNameMaxLen); 
+    table[i].name[FileNameMaxLen] = '\0';
+    table[i].sector = newSector;
+    table[i].isDir = isDir;
+    numEntries++;
+    MarkDirty(i);
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
@@ -147,20 +242,83 @@ Directory::Add(char *name, int newSector)
 // 	Remove a file name from the directory.  Return TRUE if successful;
 //	return FALSE if the file isn't in the directory. 
 //
+//	The entries after it, up to the next free slot, are moved back
+//	if their own hash slot allows, so that no entry ends up after
+//	a free slot in its probe sequence.
+//
 //	"name" -- the file name to be removed
 //----------------------------------------------------------------------
 
 bool
 Directory::Remove(char *name)
 { 
-    int i = FindIndex(name);
+    int hole = FindIndex(name);
+    int i, home;
 
-    if (i == -1)
+    if (hole == -1)
 	return FALSE; 		// name not in directory
-    table[i].inUse = FALSE;
+    table[hole].inUse = FALSE;
+    numEntries--;
+    MarkDirty(hole);
+
+    for (i = (hole + 1) % tableSize; table[i].inUse; i = (i + 1) % tableSize) {
+	home = Hash(table[i].name);
+	// can the entry at i move back to the hole?  Not if its home slot
+	// lies cyclically in (hole, i]
+	if ((hole < i) ? ((home <= hole) || (home > i))
+		       : ((home <= hole) && (home > i))) {
+	    table[hole] = table[i];
+	    table[i].inUse = FALSE;
+	    MarkDirty(i);
+	    hole = i;
+	}
+    }
     return TRUE;	
 }
 
+//----------------------------------------------------------------------
+// Directory::IsFull
+// 	Return TRUE if the directory is too full to take another file.
+//	We keep a quarter of the table free, so that the probe
+//	sequences stay short.
+//----------------------------------------------------------------------
+
+bool
+Directory::IsFull()
+{
+    return (numEntries + 1) * 4 > tableSize * 3;
+}
+
+//----------------------------------------------------------------------
+// Directory::IsEmpty
+// 	Return TRUE if there are no files in the directory, so that it
+//	may be removed.
+//----------------------------------------------------------------------
+
+bool
+Directory::IsEmpty()
+{
+    return numEntries == 0;
+}
+
+//----------------------------------------------------------------------
+// Directory::Rehash
+// 	Add every file in "from" to this directory, which must be big
+//	enough to hold them.  Used to move a full directory into a
+//	bigger table.
+//
+//	"from" -- the directory to copy
+//----------------------------------------------------------------------
+
+void
+Directory::Rehash(Directory *from)
+{
+    for (int i = 0; i < from->tableSize; i++)
+	if (from->table[i].inUse)
+	    ASSERT(Add(from->table[i].name, from->table[i].sector, 
+			from->table[i].isDir));
+}
+
 //----------------------------------------------------------------------
 // Directory::List
 // 	List all the file names in the directory. 
@@ -171,7 +329,7 @@ Directory::List()
 {
    for (int i = 0; i < tableSize; i++)
 	if (table[i].inUse)
-	    printf("%s\n", table[i].name);
+	    printf("%s%s\n", table[i].name, table[i].isDir ? "/" : "");
 }
 
 //----------------------------------------------------------------------
@@ -187,7 +345,9 @@ Directory::Print()
 
     printf("Directory contents:\n");
     for (int i = 0; i < tableSize; i++)
-	if (table[i].inUse) {
+	if (table[i].inUse && table[i].isDir)
+	    printf("Name: %s/, Sector: %d\n", table[i].name, table[i].sector);
+	else if (table[i].inUse) {
 	    printf("Name: %s, Sector: %d\n", table[i].name, table[i].sector);
 	    hdr->FetchFrom(table[i].sector);
 	    hdr->Print();
@@ -4,7 +4,9 @@
 //      A directory is a table of pairs: <file name, sector #>,
 //	giving the name of each file in the directory, and 
 //	where to find its file header (the data structure describing
-//	where to find the file's data blocks) on disk.
+//	where to find the file's data blocks) on disk.  The table is
+//	a hash table, so that finding a name does not mean comparing
+//	it against every entry.
 //
 //      We assume mutual exclusion is provided by the caller.
 //
@@ -19,8 +21,9 @@
 
 #include "openfile.h"
 
-#define FileNameMaxLen 		9	// for simplicity, we assume 
-					// file names are <= 9 characters long
+#define FileNameMaxLen 		27	// for simplicity, we assume 
+					// file names are <= 27 characters 
+					// long; longer names are truncated
 
 // The following class defines a "directory entry", representing a file
 // in the directory.  Each entry gives the name of the file, and where
@@ -32,6 +35,7 @@
 class DirectoryEntry {
   public:
     bool inUse;				// Is this directory entry in use?
+    bool isDir;				// Is the entry a subdirectory?
     int sector;				// Location on disk to find the 
 					//   FileHeader for this file 
     char name[FileNameMaxLen + 1];	// Text name for file, with +1 for 
@@ -44,9 +48,18 @@ class DirectoryEntry {
 // The directory data structure can be stored in memory, or on disk.
 // When it is on disk, it is stored as a regular Nachos file.
 //
+// Entries are placed by hashing the file name, and collisions are
+// resolved by linear probing: a name is in the first free slot at or
+// after its hash slot.  Remove shifts later entries of the same probe
+// sequence back, so that lookups can stop at the first free slot.
+// The table is never allowed to fill completely; when it gets full,
+// the file system moves the entries into a bigger table with Rehash.
+//
 // The constructor initializes a directory structure in memory; the
 // FetchFrom/WriteBack operations shuffle the directory information
-// from/to disk. 
+// from/to disk.  The directory remembers which sectors of its file
+// hold entries changed since then, so that Flush can write back
+// just those.
 
 class Directory {
   public:
@@ -57,14 +70,28 @@ class Directory {
     void FetchFrom(OpenFile *file);  	// Init directory contents from disk
     void WriteBack(OpenFile *file);	// Write modifications to 
 					// directory contents back to disk
+    void Flush(OpenFile *file);		// Write back only the sectors that
+					// were modified
 
     int Find(char *name);		// Find the sector number of the 
 					// FileHeader for file: "name"
 
-    bool Add(char *name, int newSector);  // Add a file name into the directory
+    bool IsDirectory(char *name);	// Is "name" a subdirectory?
+
+    bool Add(char *name, int newSector, bool isDir);
+					// Add a file or subdirectory name
+					// into the directory
 
     bool Remove(char *name);		// Remove a file from the directory
 
+    int TableSize() { return tableSize; }
+    DirectoryEntry *Entry(int index)	// Entry "index" of the table,
+	{ return table[index].inUse ? &table[index] : NULL; }
+					// or NULL if it is free
+    bool IsFull();			// Too full to Add another file?
+    bool IsEmpty();			// No files in the directory?
+    void Rehash(Directory *from);	// Add all of the files in "from"
+
     void List();			// Print the names of all the files
 					//  in the directory
     void Print();			// Verbose print of the contents
@@ -76,8 +103,15 @@ class Directory {
     DirectoryEntry *table;		// Table of pairs: 
 					// <file name, file header location> 
 
+    int numEntries;			// Number of entries in use
+    int numSectors;			// Sectors in the directory file
+    bool *dirty;			// Which of them have been modified
+
+    void MarkDirty(int index);		// Entry "index" has been modified
+
     int FindIndex(char *name);		// Find the index into the directory 
 					//  table corresponding to "name"
+    int Hash(char *name);		// Slot where "name" ought to be
 };
 
 #endif // DIRECTORY_H
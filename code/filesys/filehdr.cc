@@ -3,12 +3,16 @@
 //	would be called the i-node).
 //
 //	The file header is used to locate where on disk the 
-//	file's data is stored.  We implement this as a fixed size
-//	table of pointers -- each entry in the table points to the 
-//	disk sector containing that portion of the file data
-//	(in other words, there are no indirect or doubly indirect 
-//	blocks). The table size is chosen so that the file header
-//	will be just big enough to fit in one disk sector, 
+//	file's data is stored.  We implement this as a table of
+//	extents -- each entry gives the first disk sector and the
+//	length of a run of consecutive sectors holding that portion of
+//	the file data.  As many extents as fit are stored in the header
+//	sector; the rest go in a single indirect sector and then in
+//	the sectors listed by a double indirect sector.
+//
+//	When allocating, we look for free runs that continue the last
+//	extent of the file, so that most files are one extent long and
+//	can be read without seeking.
 //
 //      Unlike in a real system, we do not keep track of file permissions, 
 //	ownership, last modification date, etc., in the file header. 
@@ -27,6 +31,9 @@
 #include "system.h"
 #include "filehdr.h"
 
+#define GrowthBatch	8	// sectors to add at a time to a growing file
+#define IndirectSpare	3	// free sectors to keep for indirect sectors
+
 //----------------------------------------------------------------------
 // FileHeader::Allocate
 // 	Initialize a fresh file header for a newly created file.
@@ -35,25 +42,191 @@
 //	the new file.
 //
 //	"freeMap" is the bit map of free disk sectors
-//	"fileSize" is the bit map of free disk sectors
+//	"fileSize" is the number of bytes in the new file
 //----------------------------------------------------------------------
 
 bool
 FileHeader::Allocate(BitMap *freeMap, int fileSize)
 { 
     numBytes = fileSize;
-    numSectors  = divRoundUp(fileSize, SectorSize);
-    if (freeMap->NumClear() < numSectors)
+    numSectors = 0;
+    numExtents = 0;
+    singleIndirect = doubleIndirect = -1;
+    if (freeMap->NumClear() < divRoundUp(fileSize, SectorSize))
 	return FALSE;		// not enough space
 
-    for (int i = 0; i < numSectors; i++)
-	dataSectors[i] = freeMap->Find();
+    if (!AddSectors(freeMap, divRoundUp(fileSize, SectorSize))
+	    || !AddIndirect(freeMap)) {
+	Deallocate(freeMap);	// too fragmented, give back what we got
+	return FALSE;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::Extend
+// 	Make the file "fileSize" bytes long, if it is shorter.  If the
+//	sectors it already has are not enough, allocate more: at least
+//	GrowthBatch of them while the disk has room, so that a file
+//	growing a little at a time does not need sectors every time.
+//
+//	Return the number of sectors allocated, or -1 if there are not
+//	enough free sectors.  A few sectors are left spare for indirect
+//	sectors, so that the allocation rarely runs out of space half
+//	way; if it does, or the extent table fills up, whatever was
+//	allocated is given back, leaving the file as it was.
+//
+//	"freeMap" is the bit map of free disk sectors
+//	"fileSize" is the new length of the file in bytes
+//----------------------------------------------------------------------
+
+int
+FileHeader::Extend(BitMap *freeMap, int fileSize)
+{
+    int needed, batch, oldSectors, oldExtents, oldLength;
+    int oldSingle, oldDouble, beyond, i;
+
+    if (fileSize <= numBytes)
+	return 0;
+    needed = divRoundUp(fileSize, SectorSize) - numSectors;
+    if (needed <= 0) {
+	numBytes = fileSize;		// fits in the sectors we have
+	return 0;
+    }
+    if (freeMap->NumClear() < needed + IndirectSpare)
+	return -1;			// not enough space
+    batch = max(needed, GrowthBatch);
+    if (freeMap->NumClear() < batch + IndirectSpare)
+	batch = needed;
+
+    oldSectors = numSectors;
+    oldExtents = numExtents;
+    oldLength = (numExtents > 0) ? extents[numExtents - 1].length : 0;
+    oldSingle = singleIndirect;
+    oldDouble = doubleIndirect;
+    if (!AddSectors(freeMap, batch) || !AddIndirect(freeMap)) {
+	Truncate(freeMap, oldSectors, oldExtents, oldLength);
+	if ((oldSingle == -1) && (singleIndirect != -1)) {
+	    freeMap->Clear(singleIndirect);
+	    singleIndirect = -1;
+	}
+	if (doubleIndirect != -1) {
+	    beyond = oldExtents - NumDirectExtents - ExtentsPerSector;
+	    for (i = max(divRoundUp(beyond, ExtentsPerSector), 0);
+					i < PointersPerSector; i++)
+		if (doubleSectors[i] != -1) {
+		    freeMap->Clear(doubleSectors[i]);
+		    doubleSectors[i] = -1;
+		}
+	    if (oldDouble == -1) {
+		freeMap->Clear(doubleIndirect);
+		doubleIndirect = -1;
+	    }
+	}
+	return -1;
+    }
+    numBytes = fileSize;
+    return batch;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::Truncate
+// 	Give back the data sectors added since the file had "oldSectors"
+//	sectors in "oldExtents" extents, the last "oldLength" long.
+//----------------------------------------------------------------------
+
+void
+FileHeader::Truncate(BitMap *freeMap, int oldSectors, int oldExtents,
+		     int oldLength)
+{
+    int i, j;
+
+    if (oldExtents > 0) {
+	for (j = oldLength; j < extents[oldExtents - 1].length; j++)
+	    freeMap->Clear(extents[oldExtents - 1].start + j);
+	extents[oldExtents - 1].length = oldLength;
+    }
+    for (i = oldExtents; i < numExtents; i++)
+	for (j = 0; j < extents[i].length; j++)
+	    freeMap->Clear(extents[i].start + j);
+    numExtents = oldExtents;
+    numSectors = oldSectors;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::AddSectors
+// 	Allocate "count" more data sectors at the end of the file.  Each
+//	run is looked for right after the last extent, so that it can
+//	simply be lengthened; failing that, in the longest free run.
+//	Return FALSE if the disk is full or the extent table is.
+//----------------------------------------------------------------------
+
+bool
+FileHeader::AddSectors(BitMap *freeMap, int count)
+{
+    Extent *last;
+    int near, start, length;
+
+    while (count > 0) {
+	last = (numExtents > 0) ? &extents[numExtents - 1] : NULL;
+	near = (last != NULL) ? last->start + last->length : 0;
+	start = freeMap->FindRun(near, count, &length);
+	if (start == -1)
+	    return FALSE;
+	if ((last != NULL) && (start == near))
+	    last->length += length;
+	else if (numExtents < MaxExtents) {
+	    extents[numExtents].start = start;
+	    extents[numExtents].length = length;
+	    numExtents++;
+	} else {
+	    for (int i = 0; i < length; i++)
+		freeMap->Clear(start + i);
+	    return FALSE;
+	}
+	DEBUG('f', "Allocated %d sectors at %d\n", length, start);
+	numSectors += length;
+	count -= length;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::AddIndirect
+// 	Allocate whatever indirect sectors are needed to store the
+//	extents beyond those that fit in the header sector.  Return
+//	FALSE if the disk is full.
+//----------------------------------------------------------------------
+
+bool
+FileHeader::AddIndirect(BitMap *freeMap)
+{
+    int beyond, i;
+
+    if ((numExtents > NumDirectExtents) && (singleIndirect == -1))
+	if ((singleIndirect = freeMap->Find()) == -1)
+	    return FALSE;
+
+    beyond = numExtents - NumDirectExtents - ExtentsPerSector;
+    if (beyond <= 0)
+	return TRUE;
+    if (doubleIndirect == -1) {
+	if ((doubleIndirect = freeMap->Find()) == -1)
+	    return FALSE;
+	for (i = 0; i < PointersPerSector; i++)
+	    doubleSectors[i] = -1;
+    }
+    for (i = 0; i < divRoundUp(beyond, ExtentsPerSector); i++)
+	if ((doubleSectors[i] == -1) 
+		&& ((doubleSectors[i] = freeMap->Find()) == -1))
+	    return FALSE;
     return TRUE;
 }
 
 //----------------------------------------------------------------------
 // FileHeader::Deallocate
-// 	De-allocate all the space allocated for data blocks for this file.
+// 	De-allocate all the space allocated for data blocks for this file,
+//	and the indirect sectors listing them.
 //
 //	"freeMap" is the bit map of free disk sectors
 //----------------------------------------------------------------------
@@ -61,15 +234,67 @@ FileHeader::Allocate(BitMap *freeMap, int fileSize)
 void 
 FileHeader::Deallocate(BitMap *freeMap)
 {
-    for (int i = 0; i < numSectors; i++) {
-	ASSERT(freeMap->Test((int) dataSectors[i]));  // ought to be marked!
-	freeMap->Clear((int) dataSectors[i]);
+    int i, j;
+
+    for (i = 0; i < numExtents; i++)
+	for (j = 0; j < extents[i].length; j++) {
+	    ASSERT(freeMap->Test(extents[i].start + j));  // ought to be marked!
+	    freeMap->Clear(extents[i].start + j);
+	}
+    if (singleIndirect != -1)
+	freeMap->Clear(singleIndirect);
+    if (doubleIndirect != -1) {
+	for (i = 0; i < PointersPerSector; i++)
+	    if (doubleSectors[i] != -1)
+		freeMap->Clear(doubleSectors[i]);
+	freeMap->Clear(doubleIndirect);
+    }
+}
+
+//----------------------------------------------------------------------
+// MarkSector
+// 	Mark "sector" in "map", returning 1 if it was marked already.
+//----------------------------------------------------------------------
+
+static int
+MarkSector(BitMap *map, int sector)
+{
+    if (map->Test(sector))
+	return 1;
+    map->Mark(sector);
+    return 0;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::MarkSectors
+// 	Mark in "map" every sector this file uses besides its header:
+//	its data sectors, and the indirect sectors listing them.  Return
+//	how many of them were marked already.
+//----------------------------------------------------------------------
+
+int
+FileHeader::MarkSectors(BitMap *map)
+{
+    int i, j, marked = 0;
+
+    for (i = 0; i < numExtents; i++)
+	for (j = 0; j < extents[i].length; j++)
+	    marked += MarkSector(map, extents[i].start + j);
+    if (singleIndirect != -1)
+	marked += MarkSector(map, singleIndirect);
+    if (doubleIndirect != -1) {
+	for (i = 0; i < PointersPerSector; i++)
+	    if (doubleSectors[i] != -1)
+		marked += MarkSector(map, doubleSectors[i]);
+	marked += MarkSector(map, doubleIndirect);
     }
+    return marked;
 }
 
 //----------------------------------------------------------------------
 // FileHeader::FetchFrom
-// 	Fetch contents of file header from disk. 
+// 	Fetch contents of file header from disk, including any indirect
+//	sectors of extents.
 //
 //	"sector" is the disk sector containing the file header
 //----------------------------------------------------------------------
@@ -77,12 +302,37 @@ FileHeader::Deallocate(BitMap *freeMap)
 void
 FileHeader::FetchFrom(int sector)
 {
-    synchDisk->ReadSector(sector, (char *)this);
+    char *buf = new char[SectorSize];
+    DiskFileHeader *disk = (DiskFileHeader *) buf;
+    int i, beyond;
+
+    ASSERT(sizeof(DiskFileHeader) <= SectorSize);
+    synchDisk->ReadSector(sector, buf);
+    numBytes = disk->numBytes;
+    numSectors = disk->numSectors;
+    numExtents = disk->numExtents;
+    singleIndirect = disk->singleIndirect;
+    doubleIndirect = disk->doubleIndirect;
+    for (i = 0; (i < numExtents) && (i < NumDirectExtents); i++)
+	extents[i] = disk->direct[i];
+    delete [] buf;
+
+    if (singleIndirect != -1)
+	synchDisk->ReadSector(singleIndirect, 
+				(char *) &extents[NumDirectExtents]);
+    if (doubleIndirect != -1) {
+	synchDisk->ReadSector(doubleIndirect, (char *) doubleSectors);
+	beyond = numExtents - NumDirectExtents - ExtentsPerSector;
+	for (i = 0; i < divRoundUp(beyond, ExtentsPerSector); i++)
+	    synchDisk->ReadSector(doubleSectors[i], (char *) 
+		&extents[NumDirectExtents + (i + 1) * ExtentsPerSector]);
+    }
 }
 
 //----------------------------------------------------------------------
 // FileHeader::WriteBack
-// 	Write the modified contents of the file header back to disk. 
+// 	Write the modified contents of the file header back to disk,
+//	including any indirect sectors of extents.
 //
 //	"sector" is the disk sector to contain the file header
 //----------------------------------------------------------------------
@@ -90,7 +340,31 @@ FileHeader::FetchFrom(int sector)
 void
 FileHeader::WriteBack(int sector)
 {
-    synchDisk->WriteSector(sector, (char *)this); 
+    char *buf = new char[SectorSize];
+    DiskFileHeader *disk = (DiskFileHeader *) buf;
+    int i, beyond;
+
+    bzero(buf, SectorSize);
+    disk->numBytes = numBytes;
+    disk->numSectors = numSectors;
+    disk->numExtents = numExtents;
+    disk->singleIndirect = singleIndirect;
+    disk->doubleIndirect = doubleIndirect;
+    for (i = 0; (i < numExtents) && (i < NumDirectExtents); i++)
+	disk->direct[i] = extents[i];
+    synchDisk->WriteSector(sector, buf); 
+    delete [] buf;
+
+    if (singleIndirect != -1)
+	synchDisk->WriteSector(singleIndirect, 
+				(char *) &extents[NumDirectExtents]);
+    if (doubleIndirect != -1) {
+	synchDisk->WriteSector(doubleIndirect, (char *) doubleSectors);
+	beyond = numExtents - NumDirectExtents - ExtentsPerSector;
+	for (i = 0; i < divRoundUp(beyond, ExtentsPerSector); i++)
+	    synchDisk->WriteSector(doubleSectors[i], (char *) 
+		&extents[NumDirectExtents + (i + 1) * ExtentsPerSector]);
+    }
 }
 
 //----------------------------------------------------------------------
@@ -106,7 +380,15 @@ FileHeader::WriteBack(int sector)
 int
 FileHeader::ByteToSector(int offset)
 {
-    return(dataSectors[offset / SectorSize]);
+    int sector = offset / SectorSize;
+
+    for (int i = 0; i < numExtents; i++) {
+	if (sector < extents[i].length)
+	    return extents[i].start + sector;
+	sector -= extents[i].length;
+    }
+    ASSERT(FALSE);			// past the end of the file
+    return -1;
 }
 
 //----------------------------------------------------------------------
@@ -132,12 +414,13 @@ FileHeader::Print()
     int i, j, k;
     char *data = new char[SectorSize];
 
-    printf("FileHeader contents.  File size: %d.  File blocks:\n", numBytes);
-    for (i = 0; i < numSectors; i++)
-	printf("%d ", dataSectors[i]);
+    printf("FileHeader contents.  File size: %d.  File extents:\n", numBytes);
+    for (i = 0; i < numExtents; i++)
+	printf("%d-%d ", extents[i].start, 
+		extents[i].start + extents[i].length - 1);
     printf("\nFile contents:\n");
     for (i = k = 0; i < numSectors; i++) {
-	synchDisk->ReadSector(dataSectors[i], data);
+	synchDisk->ReadSector(ByteToSector(i * SectorSize), data);
         for (j = 0; (j < SectorSize) && (k < numBytes); j++, k++) {
 	    if ('\040' <= data[j] && data[j] <= '\176')   // isprint(data[j])
 		printf("%c", data[j]);
@@ -17,19 +17,49 @@
 #include "disk.h"
 #include "bitmap.h"
 
-#define NumDirect 	((SectorSize - 2 * sizeof(int)) / sizeof(int))
-#define MaxFileSize 	(NumDirect * SectorSize)
+// The data of a file is kept in extents: runs of consecutive disk
+// sectors.  The first few extents are listed in the header sector
+// itself; more are listed in a single indirect sector, and after that
+// in sectors pointed to by a double indirect sector.
+
+typedef struct {
+    int start;				// first disk sector of the run
+    int length;				// number of sectors in the run
+} Extent;
+
+#define NumDirectExtents ((int)((SectorSize - 5 * sizeof(int)) / sizeof(Extent)))
+#define ExtentsPerSector ((int)(SectorSize / sizeof(Extent)))
+#define PointersPerSector ((int)(SectorSize / sizeof(int)))
+#define MaxExtents	(NumDirectExtents + ExtentsPerSector \
+				+ PointersPerSector * ExtentsPerSector)
+
+// The file header as it is stored on disk, in one sector.
+
+typedef struct {
+    int numBytes;			// Number of bytes in the file
+    int numSectors;			// Number of data sectors in the file
+    int numExtents;			// Number of extents in use
+    Extent direct[NumDirectExtents];	// The first extents of the file
+    int singleIndirect;			// Sector of further extents, or -1
+    int doubleIndirect;			// Sector of sectors of further 
+					// extents, or -1
+} DiskFileHeader;
 
 // The following class defines the Nachos "file header" (in UNIX terms,  
 // the "i-node"), describing where on disk to find all of the data in the file.
-// The file header is organized as a simple table of pointers to
-// data blocks. 
+// The file header is organized as a table of extents, so that a file
+// stored contiguously needs only one entry no matter how large it is.
 //
-// The file header data structure can be stored in memory or on disk.
-// When it is on disk, it is stored in a single sector -- this means
-// that we assume the size of this data structure to be the same
-// as one disk sector.  Without indirect addressing, this
-// limits the maximum file length to just under 4K bytes.
+// On disk, the file header is stored in a single sector, plus the
+// indirect sectors needed for extents that don't fit in it.  In memory
+// all of the extents are kept in one table.  The length of a file is
+// limited only by the number of extents, and so by how fragmented
+// the free space is.
+//
+// A file can grow.  Sectors are added at its end in batches of a few
+// at a time, as close to the last extent as possible, so a file that
+// is written a bit at a time still ends up with few extents.  The
+// sectors past the end of the file are kept for it to grow into.
 //
 // There is no constructor; rather the file header can be initialized
 // by allocating blocks for the file (if it is a new file), or by
@@ -41,7 +71,12 @@ class FileHeader {
 						//  including allocating space 
 						//  on disk for the file data
     void Deallocate(BitMap *bitMap);  		// De-allocate this file's 
-						//  data blocks
+						//  data and indirect blocks
+    int MarkSectors(BitMap *bitMap);		// Mark the same blocks in
+						//  "bitMap"
+    int Extend(BitMap *bitMap, int fileSize);	// Make the file longer,
+						//  allocating more data
+						//  blocks if need be
 
     void FetchFrom(int sectorNumber); 	// Initialize file header from disk
     void WriteBack(int sectorNumber); 	// Write modifications to file header
@@ -59,8 +94,19 @@ class FileHeader {
   private:
     int numBytes;			// Number of bytes in the file
     int numSectors;			// Number of data sectors in the file
-    int dataSectors[NumDirect];		// Disk sector numbers for each data 
-					// block in the file
+    int numExtents;			// Number of extents in use
+    Extent extents[MaxExtents];		// Where the data of the file is
+    int singleIndirect;			// Indirect sectors, or -1 if not 
+    int doubleIndirect;			//  needed
+    int doubleSectors[PointersPerSector]; // Contents of doubleIndirect
+
+    bool AddSectors(BitMap *freeMap, int count);
+					// Allocate more data sectors
+    bool AddIndirect(BitMap *freeMap);	// Allocate the indirect sectors
+					// needed to hold numExtents
+    void Truncate(BitMap *freeMap, int oldSectors, int oldExtents,
+		  int oldLength);	// Give back the data sectors added
+					// since the file was that long
 };
 
 #endif // FILEHDR_H
@@ -21,23 +21,34 @@
 //	The file system assumes that the bitmap and directory files are
 //	kept "open" continuously while Nachos is running.
 //
-//	For those operations (such as Create, Remove) that modify the
-//	directory and/or bitmap, if the operation succeeds, the changes
-//	are written immediately back to disk (the two files are kept
-//	open during all this time).  If the operation fails, and we have
-//	modified part of the directory and/or bitmap, we simply discard
-//	the changed version, without writing it back to disk.
+//	Names that have been looked up are remembered in a dentry cache
+//	(cf. dcache.h), so opening a file again does not read the
+//	directory.
+//
+//	The bitmap and the root directory are also kept in memory, and
+//	operations (such as Create, Remove) that modify them only mark
+//	them dirty.  The changed sectors are written back in a batch
+//	every MetadataBatch operations, and on Sync.  If an operation
+//	fails part way, it undoes its changes to the in-memory copies.
+//	Subdirectories are read in when needed, and the sectors of them
+//	that an operation changes are written back at once.
+//
+//	Metadata is kept consistent across crashes by a write-ahead
+//	journal (cf. journal.h).  Everything an operation writes to
+//	headers and directories goes into the current transaction, and
+//	Sync, which writes back the bitmap and the root directory as
+//	well, commits it.  So after a crash the disk holds the file
+//	system as of the last Sync.  Sectors that are freed are not
+//	handed out again until then, since the last committed state
+//	still uses them; and the data of files is written out before
+//	the transaction that points at it commits.
 //
 // 	Our implementation at this point has the following restrictions:
 //
 //	   there is no synchronization for concurrent accesses
-//	   files have a fixed size, set when the file is created
-//	   files cannot be bigger than about 3KB in size
-//	   there is no hierarchical directory structure, and only a limited
-//	     number of files can be added to the system
-//	   there is no attempt to make the system robust to failures
-//	    (if Nachos exits in the middle of an operation that modifies
-//	    the file system, it may corrupt the disk)
+//	   a file that is growing should only be open once at a time
+//	    (each OpenFile has its own copy of the file header)
+//	   operations since the last Sync are lost in a crash
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -48,8 +59,11 @@
 #include "disk.h"
 #include "bitmap.h"
 #include "directory.h"
+#include "dcache.h"
 #include "filehdr.h"
 #include "filesys.h"
+#include "journal.h"
+#include "system.h"
 
 // Sectors containing the file headers for the bitmap of free sectors,
 // and the directory of files.  These file headers are placed in well-known 
@@ -57,11 +71,14 @@
 #define FreeMapSector 		0
 #define DirectorySector 	1
 
-// Initial file sizes for the bitmap and directory; until the file system
-// supports extensible files, the directory size sets the maximum number 
-// of files that can be loaded onto the disk.
+// Number of metadata changes between writing back the bitmap and the
+// root directory.
+#define MetadataBatch		16
+
+// Initial file sizes for the bitmap and directories.  A directory is
+// moved to a table twice the size each time it fills up.
 #define FreeMapFileSize 	(NumSectors / BitsInByte)
-#define NumDirEntries 		10
+#define NumDirEntries 		16
 #define DirectoryFileSize 	(sizeof(DirectoryEntry) * NumDirEntries)
 
 //----------------------------------------------------------------------
@@ -72,7 +89,7 @@
 //	not all of the sectors marked as free).  
 //
 //	If format = FALSE, we just have to open the files
-//	representing the bitmap and the directory.
+//	representing the bitmap and the directory, and read them in.
 //
 //	"format" -- should we initialize the disk?
 //----------------------------------------------------------------------
@@ -80,9 +97,15 @@
 FileSystem::FileSystem(bool format)
 { 
     DEBUG('f', "Initializing the file system.\n");
+    dentryCache = new DentryCache(DentryCacheSize);
+    releasedMap = new BitMap(NumSectors);
+    pendingChanges = 0;
+    syncDue = FALSE;
+    freeMapDirty = FALSE;
+    journal = new Journal;
     if (format) {
-        BitMap *freeMap = new BitMap(NumSectors);
-        Directory *directory = new Directory(NumDirEntries);
+        freeMap = new BitMap(NumSectors);
+        rootDirectory = new Directory(NumDirEntries);
 	FileHeader *mapHdr = new FileHeader;
 	FileHeader *dirHdr = new FileHeader;
 
@@ -92,6 +115,8 @@ FileSystem::FileSystem(bool format)
     // (make sure no one else grabs these!)
 	freeMap->Mark(FreeMapSector);	    
 	freeMap->Mark(DirectorySector);
+	for (int i = 0; i < JournalSectors; i++)
+	    freeMap->Mark(JournalStart + i);
 
     // Second, allocate space for the data blocks containing the contents
     // of the directory and bitmap files.  There better be enough space!
@@ -123,94 +148,417 @@ FileSystem::FileSystem(bool format)
 
         DEBUG('f', "Writing bitmap and directory back to disk.\n");
 	freeMap->WriteBack(freeMapFile);	 // flush changes to disk
-	directory->WriteBack(directoryFile);
+	rootDirectory->WriteBack(directoryFile);
+	journal->Format();
+	synchDisk->Sync(FALSE);
+	synchDisk->SetJournal(journal);
 
 	if (DebugIsEnabled('f')) {
 	    freeMap->Print();
-	    directory->Print();
-
-        delete freeMap; 
-	delete directory; 
+	    rootDirectory->Print();
+	}
 	delete mapHdr; 
 	delete dirHdr;
-	}
     } else {
-    // if we are not formatting the disk, just open the files representing
-    // the bitmap and directory; these are left open while Nachos is running
+    // if we are not formatting the disk, first finish whatever was
+    // committed to the journal before Nachos last stopped; then just open
+    // the files representing the bitmap and directory; these are left
+    // open while Nachos is running, and so are their contents
+	journal->Recover();
+	synchDisk->SetJournal(journal);
         freeMapFile = new OpenFile(FreeMapSector);
         directoryFile = new OpenFile(DirectorySector);
+	freeMap = new BitMap(NumSectors);
+	freeMap->FetchFrom(freeMapFile);
+	rootDirectory = new Directory(directoryFile->Length() 
+					/ sizeof(DirectoryEntry));
+	rootDirectory->FetchFrom(directoryFile);
+    }
+}
+
+//----------------------------------------------------------------------
+// FileSystem::~FileSystem
+// 	Write back the bitmap and root directory, and close their files.
+//----------------------------------------------------------------------
+
+FileSystem::~FileSystem()
+{
+    Sync();
+    synchDisk->SetJournal(NULL);
+    delete journal;
+    delete rootDirectory;
+    delete freeMap;
+    delete releasedMap;
+    delete directoryFile;
+    delete freeMapFile;
+    delete dentryCache;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Sync
+// 	Write back whatever parts of the bitmap and the root directory
+//	have changed since they were last written, and commit them, with
+//	the other metadata changed since the last Sync, as one journal
+//	transaction.  The sectors released meanwhile become free with it.
+//
+//	Not to be called in the middle of an operation, since that
+//	would commit half of it; operations ask for a Sync through
+//	MetadataChanged instead.
+//----------------------------------------------------------------------
+
+void
+FileSystem::Sync()
+{
+    ASSERT(!journal->Capturing());
+    DEBUG('f', "Writing back file system metadata.\n");
+    for (int i = 0; i < NumSectors; i++)
+	if (releasedMap->Test(i)) {
+	    releasedMap->Clear(i);
+	    freeMap->Clear(i);
+	    freeMapDirty = TRUE;
+	}
+    journal->Begin();
+    if (freeMapDirty)
+	freeMap->WriteBack(freeMapFile);
+    freeMapDirty = FALSE;
+    rootDirectory->Flush(directoryFile);
+    journal->End();
+    journal->Commit();
+    pendingChanges = 0;
+    syncDue = FALSE;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::MetadataChanged
+// 	Note that an operation has changed the bitmap and/or the root
+//	directory.  If enough changes have built up, or the journal
+//	transaction is getting big, they are written back once the
+//	operation is over.
+//----------------------------------------------------------------------
+
+void
+FileSystem::MetadataChanged()
+{
+    freeMapDirty = TRUE;
+    if ((++pendingChanges >= MetadataBatch) || journal->NeedsCommit())
+	syncDue = TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::EndOperation
+// 	Finish the journal transaction of an operation, started with
+//	journal->Begin, and Sync if the operation asked for it.
+//----------------------------------------------------------------------
+
+void
+FileSystem::EndOperation()
+{
+    journal->End();
+    if (syncDue)
+	Sync();
+}
+
+//----------------------------------------------------------------------
+// FileSystem::FetchDirectory
+// 	Read a directory into memory.  Its size is whatever the directory
+//	file has grown to.  The root directory is always in memory, and
+//	its file always open; for any other directory, a file is opened
+//	and returned in "*file", to be passed to ReleaseDirectory when
+//	done.
+//
+//	"sector" -- the sector holding the directory's file header
+//----------------------------------------------------------------------
+
+Directory *
+FileSystem::FetchDirectory(int sector, OpenFile **file)
+{
+    Directory *directory;
+
+    if (sector == DirectorySector) {
+	*file = directoryFile;
+	return rootDirectory;
+    }
+    *file = new OpenFile(sector);
+    directory = new Directory((*file)->Length() / sizeof(DirectoryEntry));
+    directory->FetchFrom(*file);
+    return directory;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::ReleaseDirectory
+// 	Close the file of a directory read by FetchDirectory, and free
+//	the in-memory copy, unless it is the root directory.
+//----------------------------------------------------------------------
+
+void
+FileSystem::ReleaseDirectory(Directory *directory, OpenFile *file)
+{
+    if (directory != rootDirectory) {
+	delete file;
+	delete directory;
+    }
+}
+
+//----------------------------------------------------------------------
+// FileSystem::WriteDirectory
+// 	Save the changes an operation made to a directory.  The root
+//	directory is written back with the next batch; any other
+//	directory has its changed sectors written now.
+//----------------------------------------------------------------------
+
+void
+FileSystem::WriteDirectory(Directory *directory, OpenFile *file)
+{
+    if (directory != rootDirectory)
+	directory->Flush(file);
+}
+
+//----------------------------------------------------------------------
+// FileSystem::GrowDirectory
+// 	Replace a full directory by one with twice as many entries.
+//	Space for the bigger directory file is allocated before the old
+//	space is released, so nothing changes if there isn't room.  The
+//	new directory and its file header are written at once; the
+//	directory goes around the journal, as it is all new sectors that
+//	nothing committed points at, and too big to log.
+//
+//	Return FALSE if there is no space.
+//
+//	"sector" -- the sector holding the directory's file header
+//	"file" -- the open directory file; reopened at the new size
+//	"directory" -- the full directory; replaced by the bigger one
+//----------------------------------------------------------------------
+
+bool
+FileSystem::GrowDirectory(int sector, OpenFile **file, Directory **directory)
+{
+    Directory *bigger = new Directory(2 * (*directory)->TableSize());
+    FileHeader *oldHdr = new FileHeader;
+    FileHeader *hdr = new FileHeader;
+
+    DEBUG('f', "Growing directory to %d entries\n", bigger->TableSize());
+    if (!hdr->Allocate(freeMap, bigger->TableSize() * sizeof(DirectoryEntry))) {
+	delete oldHdr;
+	delete hdr;
+	delete bigger;
+	return FALSE;
+    }
+    oldHdr->FetchFrom(sector);
+    oldHdr->MarkSectors(releasedMap);
+    bigger->Rehash(*directory);
+
+    hdr->WriteBack(sector);
+    delete *file;
+    *file = new OpenFile(sector);
+    journal->End();
+    bigger->WriteBack(*file);
+    journal->Begin();
+    if (sector == DirectorySector) {
+	directoryFile = *file;
+	rootDirectory = bigger;
+    }
+    freeMapDirty = TRUE;		// the caller counts the change
+
+    delete oldHdr;
+    delete hdr;
+    delete *directory;
+    *directory = bigger;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Lookup
+// 	Return the sector of the file header of "name" in the directory
+//	whose header is at "dirSector", or -1 if there is no such file.
+//	Set "*isDir" to whether it is a directory.
+//
+//	The dentry cache is tried first; only if it misses is the
+//	directory read, and the answer is then cached.
+//----------------------------------------------------------------------
+
+int
+FileSystem::Lookup(int dirSector, char *name, bool *isDir)
+{
+    Directory *directory;
+    OpenFile *file;
+    int sector = dentryCache->Lookup(dirSector, name, isDir);
+
+    if (sector != -1)
+	return sector;
+    directory = FetchDirectory(dirSector, &file);
+    sector = directory->Find(name);
+    if (sector != -1) {
+	*isDir = directory->IsDirectory(name);
+	dentryCache->Enter(dirSector, name, sector, *isDir);
+    }
+    ReleaseDirectory(directory, file);
+    return sector;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::WalkPath
+// 	Find the directory that holds the last component of "path".
+//	Components are separated by '/'; a leading '/' is optional, as
+//	all paths start at the root.  Each component but the last must
+//	name a directory.
+//
+//	Return the sector of that directory's file header, and copy the
+//	last component into "leaf", or return -1 if a directory on the
+//	way does not exist or the path has no last component.
+//
+//	"path" -- the path to walk
+//	"leaf" -- buffer of FileNameMaxLen + 1 characters
+//----------------------------------------------------------------------
+
+int
+FileSystem::WalkPath(char *path, char *leaf)
+{
+    int dirSector = DirectorySector;
+    int len;
+    bool isDir;
+
+    for (;;) {
+	while (*path == '/')
+	    path++;
+	for (len = 0; (*path != '\0') && (*path != '/'); path++)
+	    if (len < FileNameMaxLen)	// longer names are truncated
+		leaf[len++] = *path;
+	leaf[len] = '\0';
+	while (*path == '/')
+	    path++;
+	if (len == 0)
+	    return -1;
+	if (*path == '\0')
+	    return dirSector;		// leaf is the last component
+
+	dirSector = Lookup(dirSector, leaf, &isDir);
+	if ((dirSector == -1) || !isDir)
+	    return -1;
     }
 }
 
 //----------------------------------------------------------------------
 // FileSystem::Create
 // 	Create a file in the Nachos file system (similar to UNIX create).
-//	Since we can't increase the size of files dynamically, we have
-//	to give Create the initial size of the file.
+//	Files grow as they are written, but Create can also give a file
+//	an initial size, so that its sectors are allocated up front.
 //
-//	The steps to create a file are:
+//	"name" -- path of file to be created
+//	"initialSize" -- size of file to be created
+//----------------------------------------------------------------------
+
+bool
+FileSystem::Create(char *name, int initialSize)
+{
+    bool success;
+
+    DEBUG('f', "Creating file %s, size %d\n", name, initialSize);
+    journal->Begin();
+    success = AddFile(name, initialSize, FALSE);
+    EndOperation();
+    return success;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Mkdir
+// 	Create an empty directory (similar to UNIX mkdir).
+//
+//	"name" -- path of directory to be created
+//----------------------------------------------------------------------
+
+bool
+FileSystem::Mkdir(char *name)
+{
+    bool success;
+
+    DEBUG('f', "Creating directory %s\n", name);
+    journal->Begin();
+    success = AddFile(name, DirectoryFileSize, TRUE);
+    EndOperation();
+    return success;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::AddFile
+// 	Create a file or directory.  The steps are:
+//	  Find the directory it goes into
 //	  Make sure the file doesn't already exist
 //        Allocate a sector for the file header
 // 	  Allocate space on disk for the data blocks for the file
+//	  Make the directory bigger, if it is full
 //	  Add the name to the directory
 //	  Store the new file header on disk 
-//	  Flush the changes to the bitmap and the directory back to disk
+//	  For a directory, store the empty directory in it
+//	  Save the changes to the bitmap and the directory
 //
 //	Return TRUE if everything goes ok, otherwise, return FALSE.
 //
 // 	Create fails if:
+//		a directory in the path doesn't exist
 //   		file is already in directory
 //	 	no free space for file header
-//	 	no free entry for file in directory
+//	 	no free space to make the directory bigger
 //	 	no free space for data blocks for the file 
 //
 // 	Note that this implementation assumes there is no concurrent access
 //	to the file system!
 //
-//	"name" -- name of file to be created
+//	"path" -- path of file to be created
 //	"initialSize" -- size of file to be created
+//	"isDir" -- create a directory?
 //----------------------------------------------------------------------
 
 bool
-FileSystem::Create(char *name, int initialSize)
+FileSystem::AddFile(char *path, int initialSize, bool isDir)
 {
     Directory *directory;
-    BitMap *freeMap;
+    OpenFile *dirFile;
     FileHeader *hdr;
-    int sector;
-    bool success;
-
-    DEBUG('f', "Creating file %s, size %d\n", name, initialSize);
+    char name[FileNameMaxLen + 1];
+    int dirSector, sector;
+    bool success, cachedIsDir;
 
-    directory = new Directory(NumDirEntries);
-    directory->FetchFrom(directoryFile);
+    dirSector = WalkPath(path, name);
+    if (dirSector == -1)
+	return FALSE;			// no such directory
+    if (dentryCache->Lookup(dirSector, name, &cachedIsDir) != -1)
+	return FALSE;			// file is already in directory
+    directory = FetchDirectory(dirSector, &dirFile);
 
     if (directory->Find(name) != -1)
       success = FALSE;			// file is already in directory
+    else if ((sector = freeMap->Find()) == -1)
+      success = FALSE;			// no free block for file header 
     else {	
-        freeMap = new BitMap(NumSectors);
-        freeMap->FetchFrom(freeMapFile);
-        sector = freeMap->Find();	// find a sector to hold the file header
-    	if (sector == -1) 		
-            success = FALSE;		// no free block for file header 
-        else if (!directory->Add(name, sector))
-            success = FALSE;	// no space in directory
-	else {
-    	    hdr = new FileHeader;
-	    if (!hdr->Allocate(freeMap, initialSize))
-            	success = FALSE;	// no space on disk for data
-	    else {	
-	    	success = TRUE;
-		// everthing worked, flush all changes back to disk
-    	    	hdr->WriteBack(sector); 		
-    	    	directory->WriteBack(directoryFile);
-    	    	freeMap->WriteBack(freeMapFile);
+	hdr = new FileHeader;
+	if (!hdr->Allocate(freeMap, initialSize)) {
+	    freeMap->Clear(sector);
+	    success = FALSE;		// no space on disk for data
+	} else if (directory->IsFull() 
+		&& !GrowDirectory(dirSector, &dirFile, &directory)) {
+	    hdr->Deallocate(freeMap);
+	    freeMap->Clear(sector);
+	    success = FALSE;		// no space for a bigger directory
+	} else {
+	    ASSERT(directory->Add(name, sector, isDir));
+	    success = TRUE;
+	    // everthing worked, save all the changes
+	    hdr->WriteBack(sector); 		
+	    if (isDir) {
+		Directory *empty = new Directory(NumDirEntries);
+		OpenFile *file = new OpenFile(sector);
+
+		empty->WriteBack(file);
+		delete file;
+		delete empty;
 	    }
-            delete hdr;
+	    WriteDirectory(directory, dirFile);
+	    dentryCache->Enter(dirSector, name, sector, isDir);
+	    MetadataChanged();
 	}
-        delete freeMap;
+	delete hdr;
     }
-    delete directory;
+    ReleaseDirectory(directory, dirFile);
     return success;
 }
 
@@ -218,75 +566,173 @@ FileSystem::Create(char *name, int initialSize)
 // FileSystem::Open
 // 	Open a file for reading and writing.  
 //	To open a file:
-//	  Find the location of the file's header, using the directory 
+//	  Find the location of the file's header, walking the path
+//	    through the dentry cache or else the directories
 //	  Bring the header into memory
 //
-//	"name" -- the text name of the file to be opened
+//	"name" -- the path of the file to be opened
 //----------------------------------------------------------------------
 
 OpenFile *
 FileSystem::Open(char *name)
 { 
-    Directory *directory = new Directory(NumDirEntries);
-    OpenFile *openFile = NULL;
-    int sector;
+    char leaf[FileNameMaxLen + 1];
+    int dirSector, sector;
+    bool isDir;
 
     DEBUG('f', "Opening file %s\n", name);
-    directory->FetchFrom(directoryFile);
-    sector = directory->Find(name); 
-    if (sector >= 0) 		
-	openFile = new OpenFile(sector);	// name was found in directory 
-    delete directory;
-    return openFile;				// return NULL if not found
+    dirSector = WalkPath(name, leaf);
+    if (dirSector == -1)
+	return NULL;				// no such directory
+    sector = Lookup(dirSector, leaf, &isDir);
+    if ((sector == -1) || isDir)
+	return NULL;				// not found, or a directory
+    return new OpenFile(sector);
 }
 
 //----------------------------------------------------------------------
 // FileSystem::Remove
-// 	Delete a file from the file system.  This requires:
+// 	Delete a file from the file system.
+//
+//	"name" -- the path of the file to be removed
+//----------------------------------------------------------------------
+
+bool
+FileSystem::Remove(char *name)
+{ 
+    bool success;
+
+    DEBUG('f', "Removing file %s\n", name);
+    journal->Begin();
+    success = RemoveFile(name, FALSE);
+    EndOperation();
+    return success;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Rmdir
+// 	Delete a directory from the file system.  Only an empty directory
+//	can be removed.
+//
+//	"name" -- the path of the directory to be removed
+//----------------------------------------------------------------------
+
+bool
+FileSystem::Rmdir(char *name)
+{ 
+    bool success;
+
+    DEBUG('f', "Removing directory %s\n", name);
+    journal->Begin();
+    success = RemoveFile(name, TRUE);
+    EndOperation();
+    return success;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::RemoveFile
+// 	Delete a file or directory.  This requires:
 //	    Remove it from the directory
-//	    Delete the space for its header
-//	    Delete the space for its data blocks
-//	    Write changes to directory, bitmap back to disk
+//	    Release the space for its header
+//	    Release the space for its data blocks
+//	    Save the changes to the directory
+//	The space released is freed in the bitmap at the next Sync.
 //
 //	Return TRUE if the file was deleted, FALSE if the file wasn't
-//	in the file system.
+//	in the file system, is not of the expected kind, or is a
+//	directory that is not empty.
 //
-//	"name" -- the text name of the file to be removed
+//	"path" -- the path of the file to be removed
+//	"isDir" -- remove a directory?
 //----------------------------------------------------------------------
 
 bool
-FileSystem::Remove(char *name)
+FileSystem::RemoveFile(char *path, bool isDir)
 { 
-    Directory *directory;
-    BitMap *freeMap;
+    Directory *directory, *contents;
+    OpenFile *dirFile, *file;
     FileHeader *fileHdr;
-    int sector;
+    char name[FileNameMaxLen + 1];
+    int dirSector, sector;
+    bool empty;
     
-    directory = new Directory(NumDirEntries);
-    directory->FetchFrom(directoryFile);
+    dirSector = WalkPath(path, name);
+    if (dirSector == -1)
+	return FALSE;			// no such directory
+    directory = FetchDirectory(dirSector, &dirFile);
     sector = directory->Find(name);
-    if (sector == -1) {
-       delete directory;
-       return FALSE;			 // file not found 
+    if ((sector == -1) || (directory->IsDirectory(name) != isDir)) {
+	ReleaseDirectory(directory, dirFile);
+	return FALSE;			 // file not found 
+    }
+    if (isDir) {
+	contents = FetchDirectory(sector, &file);
+	empty = contents->IsEmpty();
+	ReleaseDirectory(contents, file);
+	if (!empty) {
+	    ReleaseDirectory(directory, dirFile);
+	    return FALSE;		// directory still has files in it
+	}
     }
     fileHdr = new FileHeader;
     fileHdr->FetchFrom(sector);
 
-    freeMap = new BitMap(NumSectors);
-    freeMap->FetchFrom(freeMapFile);
-
-    fileHdr->Deallocate(freeMap);  		// remove data blocks
-    freeMap->Clear(sector);			// remove header block
+    fileHdr->MarkSectors(releasedMap);		// remove data blocks
+    releasedMap->Mark(sector);			// remove header block
     directory->Remove(name);
+    dentryCache->Remove(dirSector, name);
 
-    freeMap->WriteBack(freeMapFile);		// flush to disk
-    directory->WriteBack(directoryFile);        // flush to disk
+    WriteDirectory(directory, dirFile);
+    MetadataChanged();
     delete fileHdr;
-    delete directory;
-    delete freeMap;
+    ReleaseDirectory(directory, dirFile);
     return TRUE;
 } 
 
+//----------------------------------------------------------------------
+// FileSystem::ExtendFile
+// 	Make an open file at least "length" bytes long, allocating more
+//	sectors for it if need be.  If any are allocated, the file header
+//	is written back with the new sectors, as part of the same
+//	transaction as the bitmap; otherwise only the in-memory header
+//	changes, and the OpenFile writes it back when it is closed.
+//
+//	Return FALSE if there is not enough free space.
+//
+//	"hdr" -- the open file's header
+//	"sector" -- the sector holding the file header
+//	"length" -- the new length of the file
+//----------------------------------------------------------------------
+
+bool
+FileSystem::ExtendFile(FileHeader *hdr, int sector, int length)
+{
+    int allocated;
+
+    DEBUG('f', "Extending file with header %d to %d bytes\n", sector, length);
+    journal->Begin();
+    allocated = hdr->Extend(freeMap, length);
+    if (allocated > 0) {		// -1 leaves the header as it was
+	hdr->WriteBack(sector);
+	MetadataChanged();
+    }
+    EndOperation();
+    return (allocated >= 0);
+}
+
+//----------------------------------------------------------------------
+// FileSystem::WriteHeader
+// 	Write back the header of an open file whose length has changed.
+//----------------------------------------------------------------------
+
+void
+FileSystem::WriteHeader(FileHeader *hdr, int sector)
+{
+    journal->Begin();
+    hdr->WriteBack(sector);
+    EndOperation();
+}
+
 //----------------------------------------------------------------------
 // FileSystem::List
 // 	List all the files in the file system directory.
@@ -295,11 +741,11 @@ FileSystem::Remove(char *name)
 void
 FileSystem::List()
 {
-    Directory *directory = new Directory(NumDirEntries);
+    OpenFile *file;
+    Directory *directory = FetchDirectory(DirectorySector, &file);
 
-    directory->FetchFrom(directoryFile);
     directory->List();
-    delete directory;
+    ReleaseDirectory(directory, file);
 }
 
 //----------------------------------------------------------------------
@@ -317,8 +763,8 @@ FileSystem::Print()
 {
     FileHeader *bitHdr = new FileHeader;
     FileHeader *dirHdr = new FileHeader;
-    BitMap *freeMap = new BitMap(NumSectors);
-    Directory *directory = new Directory(NumDirEntries);
+    OpenFile *file;
+    Directory *directory = FetchDirectory(DirectorySector, &file);
 
     printf("Bit map file header:\n");
     bitHdr->FetchFrom(FreeMapSector);
@@ -328,14 +774,86 @@ FileSystem::Print()
     dirHdr->FetchFrom(DirectorySector);
     dirHdr->Print();
 
-    freeMap->FetchFrom(freeMapFile);
     freeMap->Print();
 
-    directory->FetchFrom(directoryFile);
     directory->Print();
 
     delete bitHdr;
     delete dirHdr;
-    delete freeMap;
-    delete directory;
+    ReleaseDirectory(directory, file);
 } 
+
+//----------------------------------------------------------------------
+// FileSystem::Check
+// 	Check the file system, as after recovering from a crash.  Every
+//	sector reachable from the root directory, through the file
+//	headers, must be used only once and be marked in use in the
+//	bitmap; and every sector marked in use must be reachable (or
+//	be one of the fixed sectors, or the journal).  Print what is
+//	wrong, and return TRUE if nothing is.
+//----------------------------------------------------------------------
+
+bool
+FileSystem::Check()
+{
+    BitMap *used = new BitMap(NumSectors);
+    int i, problems, lost = 0, missing = 0;
+
+    for (i = 0; i < JournalSectors; i++)
+	used->Mark(JournalStart + i);
+    problems = CheckFile(FreeMapSector, FALSE, used)
+		+ CheckFile(DirectorySector, TRUE, used);
+    for (i = 0; i < NumSectors; i++) {
+	if (releasedMap->Test(i))
+	    continue;			// freed, but not committed yet
+	if (used->Test(i) && !freeMap->Test(i))
+	    missing++;
+	else if (!used->Test(i) && freeMap->Test(i))
+	    lost++;
+    }
+    if (missing > 0)
+	printf("%d sectors in use are marked free\n", missing);
+    if (lost > 0)
+	printf("%d sectors marked in use are not used\n", lost);
+    problems += missing + lost;
+    printf("File system check: %d problems\n", problems);
+    delete used;
+    return (problems == 0);
+}
+
+//----------------------------------------------------------------------
+// FileSystem::CheckFile
+// 	Mark in "used" the sectors of the file whose header is at
+//	"sector", and if it is a directory, of everything in it.  Return
+//	how many sectors were found to be used more than once.
+//----------------------------------------------------------------------
+
+int
+FileSystem::CheckFile(int sector, bool isDir, BitMap *used)
+{
+    FileHeader *hdr;
+    Directory *directory;
+    DirectoryEntry *entry;
+    OpenFile *file;
+    int i, problems;
+
+    if ((sector < 0) || (sector >= NumSectors) || used->Test(sector)) {
+	printf("File header sector %d is bad or used twice\n", sector);
+	return 1;
+    }
+    used->Mark(sector);
+    hdr = new FileHeader;
+    hdr->FetchFrom(sector);
+    problems = hdr->MarkSectors(used);
+    if (problems > 0)
+	printf("File with header %d shares %d sectors\n", sector, problems);
+    delete hdr;
+    if (isDir) {
+	directory = FetchDirectory(sector, &file);
+	for (i = 0; i < directory->TableSize(); i++)
+	    if ((entry = directory->Entry(i)) != NULL)
+		problems += CheckFile(entry->sector, entry->isDir, used);
+	ReleaseDirectory(directory, file);
+    }
+    return problems;
+}
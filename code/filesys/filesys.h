@@ -20,9 +20,9 @@
 //	file system (in a file named "DISK"). 
 //
 //	In the "real" implementation, there are two key data structures used 
-//	in the file system.  There is a single "root" directory, listing
-//	all of the files in the file system; unlike UNIX, the baseline
-//	system does not provide a hierarchical directory structure.  
+//	in the file system.  There is a "root" directory, listing the files
+//	and subdirectories at the top of the file system; as in UNIX,
+//	files are named by '/' separated paths from the root.
 //	In addition, there is a bitmap for allocating
 //	disk sectors.  Both the root directory and the bitmap are themselves
 //	stored as files in the Nachos file system -- this causes an interesting
@@ -38,6 +38,12 @@
 #include "copyright.h"
 #include "openfile.h"
 
+class BitMap;
+class Directory;
+class FileHeader;
+class DentryCache;
+class Journal;
+
 #ifdef FILESYS_STUB 		// Temporarily implement file system calls as 
 				// calls to UNIX, until the real file system
 				// implementation is available
@@ -73,6 +79,8 @@ class FileSystem {
     					// If "format", there is nothing on
 					// the disk, so initialize the directory
     					// and the bitmap of free blocks.
+    ~FileSystem();			// Write back and close the bitmap
+					// and the directory
 
     bool Create(char *name, int initialSize);  	
 					// Create a file (UNIX creat)
@@ -81,6 +89,24 @@ class FileSystem {
 
     bool Remove(char *name);  		// Delete a file (UNIX unlink)
 
+    bool Mkdir(char *name);		// Create a directory (UNIX mkdir)
+
+    bool Rmdir(char *name);		// Delete an empty directory 
+					// (UNIX rmdir)
+
+    bool ExtendFile(FileHeader *hdr, int sector, int length);
+					// Make an open file longer
+    void WriteHeader(FileHeader *hdr, int sector);
+					// Save an open file's new length
+
+    void Sync();			// Write back the changed parts of the
+					// bitmap and the root directory, and
+					// commit the journal
+
+    bool Check();			// Check that the directories and the
+					// bitmap agree on which sectors
+					// are in use
+
     void List();			// List all the files in the file system
 
     void Print();			// List all the files and their contents
@@ -90,6 +116,41 @@ class FileSystem {
 					// represented as a file
    OpenFile* directoryFile;		// "Root" directory -- list of 
 					// file names, represented as a file
+   BitMap* freeMap;			// In-memory copy of the bitmap
+   bool freeMapDirty;			// Changed since written back?
+   Directory* rootDirectory;		// In-memory copy of the root 
+					// directory
+   BitMap* releasedMap;			// Sectors freed since the last Sync;
+					// not reused until it commits
+   int pendingChanges;			// Operations since the last Sync
+   bool syncDue;			// Sync when the operation ends?
+   DentryCache* dentryCache;		// Recently looked up file names
+   Journal* journal;			// Log of metadata changes
+
+   void MetadataChanged();		// Note a change; Sync when enough
+					// have built up
+   void EndOperation();			// Close an operation's transaction
+
+   Directory* FetchDirectory(int sector, OpenFile **file);
+					// Read in a directory
+   void ReleaseDirectory(Directory *directory, OpenFile *file);
+					// Done with a fetched directory
+   void WriteDirectory(Directory *directory, OpenFile *file);
+					// Save changes to a directory
+   bool GrowDirectory(int sector, OpenFile **file, Directory **directory);
+					// Move a full directory into
+					// a bigger table
+   int Lookup(int dirSector, char *name, bool *isDir);
+					// Find a name in one directory
+   int WalkPath(char *path, char *leaf);
+					// Find the directory holding the
+					// last component of a path
+   bool AddFile(char *path, int initialSize, bool isDir);
+   bool RemoveFile(char *path, bool isDir);
+					// Create/Remove or Mkdir/Rmdir
+   int CheckFile(int sector, bool isDir, BitMap *used);
+					// Mark the sectors of a file, and of
+					// everything in it if a directory
 };
 
 #endif // FILESYS
@@ -7,6 +7,9 @@
 //	   Perftest -- a stress test for the Nachos file system
 //		read and write a really large file in tiny chunks
 //		(won't work on baseline system!)
+//	   DiskSchedulerTest -- compare disk head movement under the
+//		first come first served and C-LOOK request schedulers
+//	   DirectoryTest -- compare a flat directory with nested ones
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -20,6 +23,8 @@
 #include "thread.h"
 #include "disk.h"
 #include "stats.h"
+#include "synch.h"
+#include "synchdisk.h"
 
 #define TransferSize 	10 	// make it small, just to be difficult
 
@@ -33,7 +38,7 @@ Copy(char *from, char *to)
 {
     FILE *fp;
     OpenFile* openFile;
-    int amountRead, fileLength;
+    int amountRead;
     char *buffer;
 
 // Open UNIX file
@@ -42,14 +47,9 @@ Copy(char *from, char *to)
 	return;
     }
 
-// Figure out length of UNIX file
-    fseek(fp, 0, 2);		
-    fileLength = ftell(fp);
-    fseek(fp, 0, 0);
-
-// Create a Nachos file of the same length
-    DEBUG('f', "Copying file %s, size %d, to file %s\n", from, fileLength, to);
-    if (!fileSystem->Create(to, fileLength)) {	 // Create Nachos file
+// Create an empty Nachos file; it grows as it is written
+    DEBUG('f', "Copying file %s to file %s\n", from, to);
+    if (!fileSystem->Create(to, 0)) {	 // Create Nachos file
 	printf("Copy: couldn't create output file %s\n", to);
 	fclose(fp);
 	return;
@@ -61,7 +61,10 @@ Copy(char *from, char *to)
 // Copy the data in TransferSize chunks
     buffer = new char[TransferSize];
     while ((amountRead = fread(buffer, sizeof(char), TransferSize, fp)) > 0)
-	openFile->Write(buffer, amountRead);	
+	if (openFile->Write(buffer, amountRead) < amountRead) {
+	    printf("Copy: out of space writing %s\n", to);
+	    break;
+	}
     delete [] buffer;
 
 // Close the UNIX and the Nachos files
@@ -180,6 +183,252 @@ PerformanceTest()
       printf("Perf test: unable to remove %s\n", FileName);
       return;
     }
+    fileSystem->Sync();
+    synchDisk->Sync(FALSE);		// count the cached writes too
     stats->Print();
 }
 
+//----------------------------------------------------------------------
+// DiskSchedulerTest
+// 	Fork several threads that each read a list of scattered sectors
+//	one at a time, so that the disk always has a queue of requests
+//	from different threads to choose from.  Run the same reads first
+//	with the FIFO scheduler and then with C-LOOK, starting each run
+//	with an empty cache, and print how long the disk head spent
+//	seeking.
+//
+//	Implemented as:
+//	  SchedReader -- the body of each reading thread
+//	  SchedRun -- one run under a given policy
+//	  DiskSchedulerTest -- overall control
+//----------------------------------------------------------------------
+
+#define SchedThreads	8
+#define SchedReads	32
+
+static int schedSectors[SchedThreads][SchedReads];
+static Semaphore *schedDone;
+
+static void
+SchedReader(int which)
+{
+    char buffer[SectorSize];
+    int i;
+
+    for (i = 0; i < SchedReads; i++)
+	synchDisk->ReadSector(schedSectors[which][i], buffer);
+    schedDone->V();
+}
+
+static void
+SchedRun(char *name, DiskPolicy policy)
+{
+    int i, seekTicks, startTicks;
+    Thread *t;
+
+    synchDisk->Flush();
+    synchDisk->SetPolicy(policy);
+    seekTicks = stats->numDiskSeekTicks;
+    startTicks = stats->totalTicks;
+
+    for (i = 0; i < SchedThreads; i++) {
+	t = new Thread("disk reader", GET_NICE_FROM_PARENT);
+	t->Fork(SchedReader, i);
+    }
+    for (i = 0; i < SchedThreads; i++)
+	schedDone->P();
+
+    printf("%s: %d reads, seek ticks %d, elapsed ticks %d\n", name,
+	SchedThreads * SchedReads, stats->numDiskSeekTicks - seekTicks,
+	stats->totalTicks - startTicks);
+}
+
+void
+DiskSchedulerTest()
+{
+    int i, j;
+
+    printf("Starting disk scheduler test: %d threads, %d reads each\n",
+	SchedThreads, SchedReads);
+    for (i = 0; i < SchedThreads; i++)
+	for (j = 0; j < SchedReads; j++)
+	    schedSectors[i][j] = Random() % NumSectors;
+    schedDone = new Semaphore("disk readers", 0);
+
+    SchedRun("FIFO", DiskFIFO);
+    SchedRun("C-LOOK", DiskCLook);
+
+    synchDisk->SetPolicy(DiskCLook);
+    delete schedDone;
+}
+
+//----------------------------------------------------------------------
+// DirectoryTest
+// 	Create, open and remove a set of files, first all in the root
+//	directory and then spread over two levels of subdirectories, and
+//	print the ticks and disk reads each phase took.  The opens are
+//	done twice; the second time the dentry cache is warm.
+//
+//	Implemented as:
+//	  DirTestPath -- the path of the i'th file of a layout
+//	  DirTestReport -- print the cost of a phase
+//	  DirTestRun -- one run with a given layout
+//	  DirectoryTest -- overall control
+//----------------------------------------------------------------------
+
+#define DirTestFiles	128
+#define DirTestFanout	4	// subdirectories in each directory
+
+static void
+DirTestPath(char *path, int i, bool nested)
+{
+    if (nested)
+	sprintf(path, "/dir%d/dir%d/file%d", i % DirTestFanout,
+		(i / DirTestFanout) % DirTestFanout, i);
+    else
+	sprintf(path, "/file%d", i);
+}
+
+static void
+DirTestReport(const char *phase, int *ticks, int *reads)
+{
+    printf("  %-12s ticks %8d, disk reads %5d\n", phase,
+	stats->totalTicks - *ticks, stats->numDiskReads - *reads);
+    *ticks = stats->totalTicks;
+    *reads = stats->numDiskReads;
+}
+
+static void
+DirTestRun(char *name, bool nested)
+{
+    char path[64];
+    int i, j, ticks, reads;
+    OpenFile *openFile;
+
+    printf("%s layout, %d files:\n", name, DirTestFiles);
+    if (nested)
+	for (i = 0; i < DirTestFanout; i++) {
+	    sprintf(path, "/dir%d", i);
+	    ASSERT(fileSystem->Mkdir(path));
+	    for (j = 0; j < DirTestFanout; j++) {
+		sprintf(path, "/dir%d/dir%d", i, j);
+		ASSERT(fileSystem->Mkdir(path));
+	    }
+	}
+
+    synchDisk->Flush();
+    ticks = stats->totalTicks;
+    reads = stats->numDiskReads;
+    for (i = 0; i < DirTestFiles; i++) {
+	DirTestPath(path, i, nested);
+	if (!fileSystem->Create(path, 0)) {
+	    printf("Directory test: can't create %s\n", path);
+	    return;
+	}
+    }
+    DirTestReport("create", &ticks, &reads);
+
+    for (j = 0; j < 2; j++) {
+	for (i = 0; i < DirTestFiles; i++) {
+	    DirTestPath(path, i, nested);
+	    if ((openFile = fileSystem->Open(path)) == NULL) {
+		printf("Directory test: can't open %s\n", path);
+		return;
+	    }
+	    delete openFile;
+	}
+	DirTestReport((j == 0) ? "open" : "open again", &ticks, &reads);
+    }
+
+    for (i = 0; i < DirTestFiles; i++) {
+	DirTestPath(path, i, nested);
+	ASSERT(fileSystem->Remove(path));
+    }
+    DirTestReport("remove", &ticks, &reads);
+
+    if (nested)
+	for (i = 0; i < DirTestFanout; i++) {
+	    for (j = 0; j < DirTestFanout; j++) {
+		sprintf(path, "/dir%d/dir%d", i, j);
+		ASSERT(fileSystem->Rmdir(path));
+	    }
+	    sprintf(path, "/dir%d", i);
+	    ASSERT(fileSystem->Rmdir(path));
+	}
+}
+
+void
+DirectoryTest()
+{
+    printf("Starting directory test:\n");
+    DirTestRun("Flat", FALSE);
+    DirTestRun("Nested", TRUE);
+}
+
+//----------------------------------------------------------------------
+// ReadAheadTest
+// 	Read a file sequentially in small chunks, as FileRead does, from
+//	an empty cache, first with read ahead turned off and then with it
+//	on, and print the ticks and disk reads each run took.
+//
+//	Implemented as:
+//	  ReadAheadRun -- one sequential read of the file
+//	  ReadAheadTest -- overall control
+//----------------------------------------------------------------------
+
+#define ReadAheadFile	"ReadAheadFile"
+#define ReadAheadSize	(64 * SectorSize)
+
+static void
+ReadAheadRun(char *name, bool on)
+{
+    OpenFile *openFile;
+    char *buffer = new char[ContentSize];
+    int i, ticks, reads, hits;
+
+    synchDisk->Flush();
+    synchDisk->SetReadAhead(on);
+    ticks = stats->totalTicks;
+    reads = stats->numDiskReads;
+    hits = stats->numCacheHits;
+
+    openFile = fileSystem->Open(ReadAheadFile);
+    ASSERT(openFile != NULL);
+    for (i = 0; i + ContentSize <= ReadAheadSize; i += ContentSize)
+	if ((openFile->Read(buffer, ContentSize) < (int) ContentSize)
+		|| strncmp(buffer, Contents, ContentSize)) {
+	    printf("Read ahead test: unable to read %s\n", ReadAheadFile);
+	    break;
+	}
+    delete openFile;
+    delete [] buffer;
+
+    printf("%s: ticks %d, disk reads %d, cache hits %d\n", name,
+	stats->totalTicks - ticks, stats->numDiskReads - reads,
+	stats->numCacheHits - hits);
+}
+
+void
+ReadAheadTest()
+{
+    OpenFile *openFile;
+    int i;
+
+    printf("Starting read ahead test: %d byte file, in %d byte chunks\n",
+	ReadAheadSize, ContentSize);
+    if (!fileSystem->Create(ReadAheadFile, ReadAheadSize)) {
+	printf("Read ahead test: can't create %s\n", ReadAheadFile);
+	return;
+    }
+    openFile = fileSystem->Open(ReadAheadFile);
+    ASSERT(openFile != NULL);
+    for (i = 0; i + ContentSize <= ReadAheadSize; i += ContentSize)
+	openFile->Write(Contents, ContentSize);
+    delete openFile;
+
+    ReadAheadRun("No read ahead", FALSE);
+    ReadAheadRun("Read ahead", TRUE);
+
+    synchDisk->SetReadAhead(TRUE);
+    ASSERT(fileSystem->Remove(ReadAheadFile));
+}
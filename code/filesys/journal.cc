@@ -0,0 +1,313 @@
+// journal.cc 
+//	Routines to keep a write-ahead journal of file system metadata.
+//
+//	The log is written sequentially, from the sector after the
+//	journal header up to the end of the journal region.  Each
+//	committed transaction is one or more records, each followed by
+//	the images of the sectors it lists, all written with one disk
+//	request.  A record carries a checksum of its images, so that if
+//	Nachos dies part way through writing a transaction, recovery can
+//	tell that it is incomplete and ignore it.
+//
+//	When the log has no room for another transaction, every sector
+//	logged so far is written home (by writing back the disk cache),
+//	and the journal header is updated to say the log is empty.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "journal.h"
+#include "system.h"
+
+// Sectors in the log, after the journal header
+#define LogSectors		(JournalSectors - 1)
+
+// Log sectors taken by a transaction of "n" sectors: its images,
+// and a record per SectorsPerRecord of them
+#define LogLength(n)		((n) + divRoundUp((n), SectorsPerRecord))
+
+//----------------------------------------------------------------------
+// Journal::Journal
+// 	Initialize an empty transaction.  The log is read by Format
+//	or Recover.
+//----------------------------------------------------------------------
+
+Journal::Journal()
+{
+    ASSERT(sizeof(JournalHeader) <= SectorSize);
+    ASSERT(sizeof(LogRecord) <= SectorSize);
+    ASSERT(LogLength(MaxTransaction) <= LogSectors);
+
+    capturing = FALSE;
+    count = 0;
+    images = new char[MaxTransaction * SectorSize];
+    sequence = firstSequence = 1;
+    tail = 1;
+}
+
+//----------------------------------------------------------------------
+// Journal::~Journal
+// 	De-allocate the transaction.  Anything not committed is lost.
+//----------------------------------------------------------------------
+
+Journal::~Journal()
+{
+    delete [] images;
+}
+
+//----------------------------------------------------------------------
+// Journal::Format
+// 	Write an empty journal onto a newly formatted disk.
+//----------------------------------------------------------------------
+
+void
+Journal::Format()
+{
+    sequence = firstSequence = 1;
+    tail = 1;
+    WriteHeader();
+}
+
+//----------------------------------------------------------------------
+// Journal::Recover
+// 	Bring the disk up to date after Nachos stopped, possibly in the
+//	middle of an operation.  Every transaction in the log whose
+//	records are all intact is written to its home sectors; the log
+//	stops at the first record that is missing or damaged, since the
+//	transactions after it were never committed.  Then the log is
+//	emptied.
+//----------------------------------------------------------------------
+
+void
+Journal::Recover()
+{
+    char *buf = new char[SectorSize];
+    char *log = new char[LogSectors * SectorSize];
+    JournalHeader *header = (JournalHeader *) buf;
+    LogRecord *record;
+    int position, transactions, replayed = 0;
+
+    synchDisk->ReadSector(JournalStart, buf);
+    ASSERT(header->magic == JournalMagic);	// disk was never formatted?
+    sequence = firstSequence = header->sequence;
+    synchDisk->ReadSectors(JournalStart + 1, LogSectors, log);
+
+    // find the end of the last complete transaction
+    tail = 1;
+    for (position = 1; position < JournalSectors; ) {
+	record = (LogRecord *) &log[(position - 1) * SectorSize];
+	if ((record->magic != RecordMagic) || (record->sequence != sequence)
+		|| (record->count <= 0) || (record->count > SectorsPerRecord)
+		|| (position + 1 + record->count > JournalSectors)
+		|| (record->checksum != Checksum(&log[position * SectorSize],
+							record->count)))
+	    break;
+	position += 1 + record->count;
+	if (record->last) {
+	    tail = position;
+	    sequence++;
+	}
+    }
+
+    // write the images of those transactions home, oldest first, so
+    // that a later copy of a sector wins
+    for (position = 1; position < tail; position += 1 + record->count) {
+	record = (LogRecord *) &log[(position - 1) * SectorSize];
+	for (int i = 0; i < record->count; i++)
+	    synchDisk->WriteSector(record->home[i],
+				&log[(position + i) * SectorSize]);
+	replayed += record->count;
+    }
+    transactions = sequence - firstSequence;
+    if (transactions > 0)
+	printf("Journal: replayed %d transactions (%d sectors)\n",
+					transactions, replayed);
+
+    Checkpoint();
+    delete [] log;
+    delete [] buf;
+}
+
+//----------------------------------------------------------------------
+// Journal::Index
+// 	Return where "sector" is among the sectors of the transaction,
+//	or -1 if the transaction has not changed it.
+//----------------------------------------------------------------------
+
+int
+Journal::Index(int sector)
+{
+    for (int i = 0; i < count; i++)
+	if (home[i] == sector)
+	    return i;
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// Journal::Log
+// 	Add a new image of "sector" to the transaction, replacing any
+//	earlier image of it.
+//----------------------------------------------------------------------
+
+void
+Journal::Log(int sector, char *data)
+{
+    int i = Index(sector);
+
+    ASSERT((sector < JournalStart) || (sector >= JournalStart + JournalSectors));
+    if (i == -1) {
+	ASSERT(count < MaxTransaction);	// should have committed earlier
+	i = count++;
+	home[i] = sector;
+    }
+    bcopy(data, &images[i * SectorSize], SectorSize);
+}
+
+//----------------------------------------------------------------------
+// Journal::Find
+// 	If the transaction has changed "sector", copy its new contents
+//	into "data" and return TRUE.
+//----------------------------------------------------------------------
+
+bool
+Journal::Find(int sector, char *data)
+{
+    int i = Index(sector);
+
+    if (i == -1)
+	return FALSE;
+    bcopy(&images[i * SectorSize], data, SectorSize);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Journal::Forget
+// 	Drop "sector" from the transaction, because it is being written
+//	outside of it (for instance, it was freed and has become part of
+//	a file).
+//----------------------------------------------------------------------
+
+void
+Journal::Forget(int sector)
+{
+    int i = Index(sector);
+
+    if (i == -1)
+	return;
+    count--;
+    home[i] = home[count];
+    bcopy(&images[count * SectorSize], &images[i * SectorSize], SectorSize);
+}
+
+//----------------------------------------------------------------------
+// Journal::Commit
+// 	Make the transaction durable.  Its records and images are
+//	written into the log with one request; once that is done, the
+//	operations in it will survive a crash.  The images are then
+//	handed to the disk cache like any other write, to go home
+//	whenever the cache writes them back.
+//
+//	The cache is written back first, so that file data, which is not
+//	logged, is on the disk before any header that points at it.
+//----------------------------------------------------------------------
+
+void
+Journal::Commit()
+{
+    char *buf;
+    LogRecord *record;
+    int done, n, length, position;
+
+    if (count == 0)
+	return;
+    synchDisk->Sync(FALSE);
+    length = LogLength(count);
+    if (tail + length > JournalSectors)
+	Checkpoint();			// not enough room left in the log
+
+    buf = new char[length * SectorSize];
+    bzero(buf, length * SectorSize);
+    for (done = 0, position = 0; done < count; done += n) {
+	n = min(count - done, SectorsPerRecord);
+	record = (LogRecord *) &buf[position * SectorSize];
+	record->magic = RecordMagic;
+	record->sequence = sequence;
+	record->count = n;
+	record->last = (done + n == count);
+	bcopy(&home[done], record->home, n * sizeof(int));
+	bcopy(&images[done * SectorSize], &buf[(position + 1) * SectorSize],
+						n * SectorSize);
+	record->checksum = Checksum(&buf[(position + 1) * SectorSize], n);
+	position += 1 + n;
+    }
+    ASSERT(position == length);
+
+    DEBUG('f', "Journal commit %d: %d sectors at log sector %d\n",
+					sequence, count, tail);
+    synchDisk->WriteThrough(JournalStart + tail, length, buf);
+    tail += length;
+    sequence++;
+
+    // the transaction is safe; let its sectors go home
+    count = 0;
+    for (position = 0; position < length; position += 1 + record->count) {
+	record = (LogRecord *) &buf[position * SectorSize];
+	for (int i = 0; i < record->count; i++)
+	    synchDisk->WriteSector(record->home[i],
+				&buf[(position + 1 + i) * SectorSize]);
+    }
+    delete [] buf;
+}
+
+//----------------------------------------------------------------------
+// Journal::Checkpoint
+// 	Write every committed sector home, by writing back the disk
+//	cache, and then mark the log empty.  Transactions written to
+//	the log after this one have a higher sequence number, so the
+//	stale records left in the log are never mistaken for them.
+//----------------------------------------------------------------------
+
+void
+Journal::Checkpoint()
+{
+    DEBUG('f', "Journal checkpoint at sequence %d\n", sequence);
+    synchDisk->Sync(FALSE);
+    firstSequence = sequence;
+    tail = 1;
+    WriteHeader();
+}
+
+//----------------------------------------------------------------------
+// Journal::WriteHeader
+// 	Write the journal header, straight to the disk.
+//----------------------------------------------------------------------
+
+void
+Journal::WriteHeader()
+{
+    char *buf = new char[SectorSize];
+    JournalHeader *header = (JournalHeader *) buf;
+
+    bzero(buf, SectorSize);
+    header->magic = JournalMagic;
+    header->sequence = firstSequence;
+    synchDisk->WriteThrough(JournalStart, 1, buf);
+    delete [] buf;
+}
+
+//----------------------------------------------------------------------
+// Journal::Checksum
+// 	Return a checksum of "sectors" sector images in "data".
+//----------------------------------------------------------------------
+
+unsigned int
+Journal::Checksum(char *data, int sectors)
+{
+    unsigned int sum = 0;
+
+    for (int i = 0; i < sectors * SectorSize; i++)
+	sum = (sum << 5) + sum + (unsigned char) data[i];
+    return sum;
+}
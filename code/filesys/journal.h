@@ -0,0 +1,108 @@
+// journal.h 
+//	Data structures for the write-ahead journal of file system
+//	metadata.
+//
+//	Changes to file headers, directories and the bitmap are grouped
+//	into transactions.  A transaction is committed by writing all of
+//	the sectors it changed into a log on the disk, in one request;
+//	only after that do the sectors go to their home locations, which
+//	can happen lazily, since after a crash the log is replayed.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "disk.h"
+
+// The journal lives in a fixed region of the disk, right after the
+// headers of the bitmap and the root directory.  Its first sector
+// holds the journal header; the rest is the log.
+
+#define JournalStart		2	// first sector of the journal
+#define JournalSectors		128	// sectors in the journal
+#define JournalMagic		0x4a4e4c31
+#define RecordMagic		0x4a524331
+
+// Sectors listed in one log record, and the most sectors one
+// transaction may change (so that it fits in the log, with its records)
+#define SectorsPerRecord	((int)((SectorSize - 5 * sizeof(int)) / sizeof(int)))
+#define MaxTransaction		120
+
+// The journal header.  Log records with sequence numbers below
+// "sequence" have been checkpointed, and are ignored.
+
+typedef struct {
+    int magic;
+    int sequence;			// of the first record in the log
+} JournalHeader;
+
+// A log record: lists the home sectors of the up to SectorsPerRecord
+// sector images that follow it in the log.  The records of a transaction
+// share a sequence number; the last one is flagged.
+
+typedef struct {
+    int magic;
+    int sequence;			// transaction this record is part of
+    int count;				// sector images that follow
+    int last;				// last record of the transaction?
+    unsigned int checksum;		// of the images, to catch a torn write
+    int home[SectorsPerRecord];		// where each image belongs
+} LogRecord;
+
+// The following class defines the journal.  The file system brackets
+// each operation with Begin/End; while an operation is under way,
+// SynchDisk hands the sectors it is asked to write to Log instead of
+// writing them.  Until the transaction commits, reads of those sectors
+// are answered by Find.  Commit writes the transaction to the log and
+// then lets the sectors go to the disk cache, to be written home
+// whenever the cache writes them back.  When the log fills up, it is
+// checkpointed: the cache is flushed, and the log is emptied.
+
+class Journal {
+  public:
+    Journal();				// Initialize an empty transaction
+    ~Journal();
+
+    void Format();			// Initialize an empty journal on disk
+    void Recover();			// Replay committed transactions from
+					// the log, and empty it
+
+    void Begin() { capturing = TRUE; }	// Metadata writes go to the log
+    void End() { capturing = FALSE; }	// Writes go to the disk again
+    bool Capturing() { return capturing; }
+    bool Pending() { return count > 0; }
+					// Any uncommitted sectors?
+    bool NeedsCommit() { return count >= MaxTransaction / 2; }
+					// Big enough to commit now?
+
+    void Log(int sector, char *data);	// Add a sector to the transaction
+    bool Find(int sector, char *data);	// Get a sector from the transaction
+    void Forget(int sector);		// Drop a sector that is now being
+					// written as ordinary data
+
+    void Commit();			// Make the transaction durable
+    void Checkpoint();			// Flush home sectors; empty the log
+
+  private:
+    bool capturing;			// Inside a file system operation?
+    int count;				// Sectors in the transaction
+    int home[MaxTransaction];		// Their home locations
+    char *images;			// Their new contents
+
+    int sequence;			// Of the next transaction
+    int firstSequence;			// Of the first one in the log
+    int tail;				// Next free sector of the log,
+					// counted from JournalStart
+
+    int Index(int sector);		// Where "sector" is in the
+					// transaction, or -1
+    unsigned int Checksum(char *data, int sectors);
+    void WriteHeader();			// Write the journal header
+};
+
+#endif // JOURNAL_H
@@ -5,7 +5,14 @@
 //	the OpenFile data structure).
 //
 //	Also as in UNIX, for convenience, we keep the file header in
-//	memory while the file is open.
+//	memory while the file is open.  Writing past the end of the file
+//	makes it longer; the header is written back when new sectors are
+//	allocated, and when the file is closed.
+//
+//	Each open file watches whether it is being read sequentially,
+//	and if so has the sectors that come next read into the disk
+//	cache ahead of time.  The read-ahead window starts small and
+//	doubles with each new sector read in order, up to MaxReadAhead.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -16,6 +23,10 @@
 #include "openfile.h"
 #include "system.h"
 
+#define MinReadAhead	2	// sectors read ahead once reads look
+				// sequential
+#define MaxReadAhead	8	// most sectors kept read ahead
+
 //----------------------------------------------------------------------
 // OpenFile::OpenFile
 // 	Open a Nachos file for reading and writing.  Bring the file header
@@ -28,16 +39,24 @@ OpenFile::OpenFile(int sector)
 { 
     hdr = new FileHeader;
     hdr->FetchFrom(sector);
+    hdrSector = sector;
+    hdrDirty = FALSE;
     seekPosition = 0;
+    lastSector = -1;			// so reading from the start counts
+    readAheadWindow = 0;		// as sequential
+    readAheadEnd = 0;
 }
 
 //----------------------------------------------------------------------
 // OpenFile::~OpenFile
 // 	Close a Nachos file, de-allocating any in-memory data structures.
+//	If the file has grown, save its new length.
 //----------------------------------------------------------------------
 
 OpenFile::~OpenFile()
 {
+    if (hdrDirty)
+	fileSystem->WriteHeader(hdr, hdrSector);
     delete hdr;
 }
 
@@ -84,6 +103,24 @@ OpenFile::Write(char *into, int numBytes)
    return result;
 }
 
+//----------------------------------------------------------------------
+// SectorRun
+// 	Return how many of the file sectors from "first" up to and
+//	including "last" follow "first" consecutively on the disk.
+//----------------------------------------------------------------------
+
+static int
+SectorRun(FileHeader *hdr, int first, int last)
+{
+    int disk = hdr->ByteToSector(first * SectorSize);
+    int count = 1;
+
+    while ((first + count <= last) &&
+	   (hdr->ByteToSector((first + count) * SectorSize) == disk + count))
+	count++;
+    return count;
+}
+
 //----------------------------------------------------------------------
 // OpenFile::ReadAt/WriteAt
 // 	Read/write a portion of a file, starting at "position".
@@ -95,13 +132,21 @@ OpenFile::Write(char *into, int numBytes)
 //	sector at a time.  Thus:
 //
 //	For ReadAt:
-//	   We read in all of the full or partial sectors that are part of the
-//	   request, but we only copy the part we are interested in.
+//	   A partial sector at either end of the request is read into a
+//	   sector-sized buffer, and we only copy the part we are interested
+//	   in.  Whole sectors are read straight into the caller's buffer.
 //	For WriteAt:
-//	   We must first read in any sectors that will be partially written,
+//	   If the write goes past the end of the file, the file is first
+//	   made longer; if there isn't room for that, only the part that
+//	   fits in the file is written.
+//	   We must first read in any sector that will be partially written,
 //	   so that we don't overwrite the unmodified portion.  We then copy
-//	   in the data that will be modified, and write back all the full
-//	   or partial sectors that are part of the request.
+//	   in the data that will be modified and write the sector back.
+//	   Whole sectors are written straight from the caller's buffer.
+//
+//	Whole sectors that are also consecutive on the disk are transferred
+//	with a single SynchDisk::ReadSectors/WriteSectors call, so a
+//	contiguous file costs one disk request rather than one per sector.
 //
 //	"into" -- the buffer to contain the data to be read from disk 
 //	"from" -- the buffer containing the data to be written to disk 
@@ -114,8 +159,8 @@ int
 OpenFile::ReadAt(char *into, int numBytes, int position)
 {
     int fileLength = hdr->FileLength();
-    int i, firstSector, lastSector, numSectors;
-    char *buf;
+    int sector, offset, amount, count, lastWhole;
+    char buf[SectorSize];
 
     if ((numBytes <= 0) || (position >= fileLength))
     	return 0; 				// check request
@@ -124,19 +169,26 @@ OpenFile::ReadAt(char *into, int numBytes, int position)
     DEBUG('f', "Reading %d bytes at %d, from file of length %d.\n", 	
 			numBytes, position, fileLength);
 
-    firstSector = divRoundDown(position, SectorSize);
-    lastSector = divRoundDown(position + numBytes - 1, SectorSize);
-    numSectors = 1 + lastSector - firstSector;
-
-    // read in all the full and partial sectors that we need
-    buf = new char[numSectors * SectorSize];
-    for (i = firstSector; i <= lastSector; i++)	
-        synchDisk->ReadSector(hdr->ByteToSector(i * SectorSize), 
-					&buf[(i - firstSector) * SectorSize]);
-
-    // copy the part we want
-    bcopy(&buf[position - (firstSector * SectorSize)], into, numBytes);
-    delete [] buf;
+    for (int done = 0; done < numBytes; done += amount) {
+	sector = divRoundDown(position + done, SectorSize);
+	offset = (position + done) - sector * SectorSize;
+	amount = numBytes - done;
+	if ((offset != 0) || (amount < SectorSize)) {
+	    // partial sector, copy the part we want
+	    if (amount > SectorSize - offset)
+		amount = SectorSize - offset;
+	    synchDisk->ReadSector(hdr->ByteToSector(sector * SectorSize), buf);
+	    bcopy(&buf[offset], &into[done], amount);
+	} else {
+	    lastWhole = sector + amount / SectorSize - 1;
+	    count = SectorRun(hdr, sector, lastWhole);
+	    amount = count * SectorSize;
+	    synchDisk->ReadSectors(hdr->ByteToSector(sector * SectorSize),
+					count, &into[done]);
+	}
+    }
+    ReadAhead(divRoundDown(position, SectorSize),
+		divRoundDown(position + numBytes - 1, SectorSize));
     return numBytes;
 }
 
@@ -144,42 +196,67 @@ int
 OpenFile::WriteAt(char *from, int numBytes, int position)
 {
     int fileLength = hdr->FileLength();
-    int i, firstSector, lastSector, numSectors;
-    bool firstAligned, lastAligned;
-    char *buf;
+    int sector, offset, amount, count, lastWhole;
+    char buf[SectorSize];
 
-    if ((numBytes <= 0) || (position >= fileLength))
+    if ((numBytes <= 0) || (position < 0))
 	return 0;				// check request
-    if ((position + numBytes) > fileLength)
-	numBytes = fileLength - position;
+    if ((position + numBytes) > fileLength) {
+	if (fileSystem->ExtendFile(hdr, hdrSector, position + numBytes)) {
+	    if (position > fileLength)
+		ZeroFill(fileLength, position);	// don't expose old data
+	    fileLength = hdr->FileLength();
+	    hdrDirty = TRUE;
+	} else if (position >= fileLength)
+	    return 0;				// disk full
+	else
+	    numBytes = fileLength - position;
+    }
     DEBUG('f', "Writing %d bytes at %d, from file of length %d.\n", 	
 			numBytes, position, fileLength);
 
-    firstSector = divRoundDown(position, SectorSize);
-    lastSector = divRoundDown(position + numBytes - 1, SectorSize);
-    numSectors = 1 + lastSector - firstSector;
-
-    buf = new char[numSectors * SectorSize];
-
-    firstAligned = (position == (firstSector * SectorSize));
-    lastAligned = ((position + numBytes) == ((lastSector + 1) * SectorSize));
+    for (int done = 0; done < numBytes; done += amount) {
+	sector = divRoundDown(position + done, SectorSize);
+	offset = (position + done) - sector * SectorSize;
+	amount = numBytes - done;
+	if ((offset != 0) || (amount < SectorSize)) {
+	    // partial sector, read-modify-write
+	    if (amount > SectorSize - offset)
+		amount = SectorSize - offset;
+	    synchDisk->ReadSector(hdr->ByteToSector(sector * SectorSize), buf);
+	    bcopy(&from[done], &buf[offset], amount);
+	    synchDisk->WriteSector(hdr->ByteToSector(sector * SectorSize), buf);
+	} else {
+	    lastWhole = sector + amount / SectorSize - 1;
+	    count = SectorRun(hdr, sector, lastWhole);
+	    amount = count * SectorSize;
+	    synchDisk->WriteSectors(hdr->ByteToSector(sector * SectorSize),
+					count, &from[done]);
+	}
+    }
+    return numBytes;
+}
 
-// read in first and last sector, if they are to be partially modified
-    if (!firstAligned)
-        ReadAt(buf, SectorSize, firstSector * SectorSize);	
-    if (!lastAligned && ((firstSector != lastSector) || firstAligned))
-        ReadAt(&buf[(lastSector - firstSector) * SectorSize], 
-				SectorSize, lastSector * SectorSize);	
+//----------------------------------------------------------------------
+// OpenFile::ZeroFill
+// 	Clear the bytes of the file from "from" up to "to", which the
+//	file has just grown to cover.  The sectors there may have
+//	belonged to a deleted file, or, past the old end of the file's
+//	last sector, hold whatever was read-modify-written with it; as
+//	in UNIX, reading a gap left by a write past the end of the file
+//	returns zeroes.
+//----------------------------------------------------------------------
 
-// copy in the bytes we want to change 
-    bcopy(from, &buf[position - (firstSector * SectorSize)], numBytes);
+void
+OpenFile::ZeroFill(int from, int to)
+{
+    static char zeroes[SectorSize];	// all zero, being static
+    int amount;
 
-// write modified sectors back
-    for (i = firstSector; i <= lastSector; i++)	
-        synchDisk->WriteSector(hdr->ByteToSector(i * SectorSize), 
-					&buf[(i - firstSector) * SectorSize]);
-    delete [] buf;
-    return numBytes;
+    for (; from < to; from += amount) {
+	amount = min(to - from, SectorSize - from % SectorSize);
+	WriteAt(zeroes, amount, from);
+    }
 }
 
 //----------------------------------------------------------------------
@@ -192,3 +269,48 @@ OpenFile::Length()
 { 
     return hdr->FileLength(); 
 }
+
+//----------------------------------------------------------------------
+// OpenFile::ReadAhead
+// 	Called after reading file sectors "first" to "last".  A read that
+//	starts in the sector the previous one ended in, or the one after,
+//	is sequential; anything else turns read ahead off until reads are
+//	sequential again.
+//
+//	Each time sequential reads move on to a new sector, the window
+//	grows, and once less than half of it is left ahead of the reader,
+//	the sectors up to the end of the window are prefetched, one
+//	request per run of consecutive disk sectors.
+//----------------------------------------------------------------------
+
+void
+OpenFile::ReadAhead(int first, int last)
+{
+    int numSectors = divRoundUp(hdr->FileLength(), SectorSize);
+    int start, end, count;
+
+    if ((first != lastSector) && (first != lastSector + 1)) {
+	readAheadWindow = 0;		// random access
+	lastSector = last;
+	readAheadEnd = last + 1;
+	return;
+    }
+    if (last == lastSector)
+	return;				// still in the same sector
+    lastSector = last;
+    if (readAheadWindow == 0)
+	readAheadWindow = MinReadAhead;
+    else
+	readAheadWindow = min(2 * readAheadWindow, MaxReadAhead);
+    if (readAheadEnd > last + readAheadWindow / 2)
+	return;				// enough is on its way
+
+    start = max(readAheadEnd, last + 1);
+    end = min(last + readAheadWindow, numSectors - 1);
+    for (int sector = start; sector <= end; sector += count) {
+	count = SectorRun(hdr, sector, end);
+	synchDisk->Prefetch(hdr->ByteToSector(sector * SectorSize), count);
+    }
+    if (start <= end)
+	readAheadEnd = end + 1;
+}
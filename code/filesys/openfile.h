@@ -88,7 +88,23 @@ class OpenFile {
     
   private:
     FileHeader *hdr;			// Header for this file 
+    int hdrSector;			// Where the header is on disk
+    bool hdrDirty;			// Has the file grown since the header
+					// was written back?
     int seekPosition;			// Current position within the file
+
+    int lastSector;			// Last file sector read
+    int readAheadWindow;		// Sectors to keep read ahead of the
+					// reader; 0 unless reads are
+					// sequential
+    int readAheadEnd;			// File sectors before this one
+					// have been read ahead
+
+    void ReadAhead(int first, int last);
+					// Note a read of file sectors
+					// "first" to "last"; if reads are
+					// sequential, read ahead
+    void ZeroFill(int from, int to);	// Clear bytes "from" up to "to"
 };
 
 #endif // FILESYS
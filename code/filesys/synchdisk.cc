@@ -5,10 +5,19 @@
 //	the disk providing a synchronous interface (requests wait until
 //	the request completes).
 //
-//	Use a semaphore to synchronize the interrupt handlers with the
-//	pending requests.  And, because the physical disk can only
-//	handle one operation at a time, use a lock to enforce mutual
-//	exclusion.
+//	Each request carries a semaphore to synchronize the interrupt
+//	handler with the thread waiting for it.  Because the physical disk
+//	can only handle one operation at a time, requests that arrive while
+//	it is busy are queued, and the interrupt handler starts the next
+//	one.  The queue is shared with the interrupt handler, so it is
+//	protected by disabling interrupts.
+//
+//	Sectors are cached, with LRU replacement and write-back of dirty
+//	sectors.  Since Lock is not implemented yet, a semaphore guards
+//	the cache.  The one exception is the interrupt handler filling
+//	in sectors read ahead: it only touches entries marked as loading,
+//	which threads leave alone except to wait for them or overwrite
+//	them whole.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -16,6 +25,8 @@
 
 #include "copyright.h"
 #include "synchdisk.h"
+#include "journal.h"
+#include "system.h"
 
 //----------------------------------------------------------------------
 // DiskRequestDone
@@ -38,13 +49,38 @@ DiskRequestDone (int arg)
 //
 //	"name" -- UNIX file name to be used as storage for the disk data
 //	   (usually, "DISK")
+//	"cacheSectors" -- how many sectors to cache
 //----------------------------------------------------------------------
 
-SynchDisk::SynchDisk(char* name)
+SynchDisk::SynchDisk(char* name, int cacheSectors)
 {
-    semaphore = new Semaphore("synch disk", 0);
-    lock = new Lock("synch disk lock");
+    int i;
+
     disk = new Disk(name, DiskRequestDone, (int) this);
+    policy = DiskCLook;
+    current = waiting = NULL;
+    headTrack = 0;
+    readAhead = TRUE;
+    writeCount = 0;
+    halted = FALSE;
+    journal = NULL;
+    crashCountdown = 0;
+
+    ASSERT(cacheSectors >= 0);
+    cacheSize = cacheSectors;
+    cache = new CacheEntry[cacheSize];
+    for (i = 0; i < cacheSize; i++) {
+	cache[i].sector = -1;
+	cache[i].dirty = FALSE;
+	cache[i].loading = FALSE;
+	cache[i].loader = NULL;
+	cache[i].waiters = 0;
+	cache[i].loaded = new Semaphore("sector read ahead", 0);
+	cache[i].lastUsed = 0;
+    }
+    useCount = 0;
+    numLoading = 0;
+    cacheLock = new Semaphore("synch disk cache", 1);
 }
 
 //----------------------------------------------------------------------
@@ -55,15 +91,229 @@ SynchDisk::SynchDisk(char* name)
 
 SynchDisk::~SynchDisk()
 {
+    for (int i = 0; i < cacheSize; i++)
+	delete cache[i].loaded;
+    delete cacheLock;
+    delete [] cache;
     delete disk;
-    delete lock;
-    delete semaphore;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::DiskRead
+// 	Read consecutive disk sectors into a buffer with one request,
+//	bypassing the cache.  Return only after the data has been read.
+//
+//	"firstSector" -- the first disk sector to read
+//	"count" -- how many sectors
+//	"data" -- the buffer to hold the contents of the disk sectors
+//----------------------------------------------------------------------
+
+void
+SynchDisk::DiskRead(int firstSector, int count, char* data)
+{
+    Transfer(firstSector, count, data, FALSE);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::DiskWrite
+// 	Write a buffer into consecutive disk sectors with one request,
+//	bypassing the cache.  Return only after the data has been written.
+//
+//	If a crash was asked for with CrashAfter, and this is the write
+//	it should happen in, write only the first half of the sectors,
+//	as if the power failed part way, and stop Nachos on the spot.
+//
+//	"firstSector" -- the first disk sector to be written
+//	"count" -- how many sectors
+//	"data" -- the new contents of the disk sectors
+//----------------------------------------------------------------------
+
+void
+SynchDisk::DiskWrite(int firstSector, int count, char* data)
+{
+    if ((crashCountdown > 0) && (--crashCountdown == 0)) {
+	Drain();			// the disk must be idle to write now
+	for (int i = 0; i < count / 2; i++)
+	    disk->WriteNow(firstSector + i, &data[i * SectorSize]);
+	printf("Simulated crash writing sectors %d-%d\n", firstSector,
+					firstSector + count - 1);
+	Exit(1);
+    }
+    writeCount++;
+    Transfer(firstSector, count, data, TRUE);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Drain
+// 	Roll simulated time forward until the disk has finished every
+//	request queued for it, so that the disk is idle and sectors can
+//	be read or written at once.  Threads waiting for their requests
+//	are woken up, but do not get to run.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Drain()
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    MachineStatus oldStatus = interrupt->getStatus();
+
+    while (current != NULL)		// RequestDone starts the next one
+	interrupt->Idle();		// the disk interrupt is pending
+    interrupt->setStatus(oldStatus);
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Transfer
+// 	Queue a disk request, starting it at once if the disk is idle,
+//	and wait for it to complete.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Transfer(int firstSector, int count, char* data, bool writing)
+{
+    DiskRequest request;
+
+    if (halted) {			// nobody left to wait for the disk
+	for (int i = 0; i < count; i++)
+	    if (writing)
+		disk->WriteNow(firstSector + i, &data[i * SectorSize]);
+	    else
+		disk->ReadNow(firstSector + i, &data[i * SectorSize]);
+	return;
+    }
+
+    request.firstSector = firstSector;
+    request.count = count;
+    request.data = data;
+    request.writing = writing;
+    request.done = new Semaphore("disk request", 0);
+    Queue(&request);
+    request.done->P();			// wait for interrupt
+    delete request.done;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Queue
+// 	Add a request to the end of the waiting queue, and send it to the
+//	disk at once if the disk is idle.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Queue(DiskRequest *request)
+{
+    DiskRequest **last;
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    request->next = NULL;
+    for (last = &waiting; *last != NULL; last = &(*last)->next)
+	;
+    *last = request;
+    if (current == NULL)
+	StartNext();
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::StartNext
+// 	Take the next request off the waiting queue and send it to the
+//	disk.  First come first served just takes the oldest one.  C-LOOK
+//	takes the request on the lowest track at or beyond the head; if
+//	there is none, the sweep is over and it takes the lowest track
+//	of all.  Ties go to the oldest request.  Called with interrupts
+//	off.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::StartNext()
+{
+    DiskRequest **ptr, **best = NULL, **lowest = NULL;
+    int track;
+
+    ASSERT(current == NULL);
+    if (waiting == NULL)
+	return;
+    if (policy == DiskFIFO)
+	best = &waiting;
+    else {
+	for (ptr = &waiting; *ptr != NULL; ptr = &(*ptr)->next) {
+	    track = (*ptr)->firstSector / SectorsPerTrack;
+	    if ((lowest == NULL)
+		    || (track < (*lowest)->firstSector / SectorsPerTrack))
+		lowest = ptr;
+	    if ((track >= headTrack) && ((best == NULL)
+		    || (track < (*best)->firstSector / SectorsPerTrack)))
+		best = ptr;
+	}
+	if (best == NULL)
+	    best = lowest;
+    }
+
+    current = *best;
+    *best = current->next;
+    headTrack = (current->firstSector + current->count - 1) / SectorsPerTrack;
+    if (current->writing)
+	disk->WriteSectors(current->firstSector, current->count, current->data);
+    else
+	disk->ReadSectors(current->firstSector, current->count, current->data);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Lookup
+// 	Return the cache entry holding "sectorNumber", marking it as
+//	recently used, or NULL if the sector is not cached.  Must be
+//	called with cacheLock held.
+//----------------------------------------------------------------------
+
+CacheEntry *
+SynchDisk::Lookup(int sectorNumber)
+{
+    int i;
+
+    for (i = 0; i < cacheSize; i++) {
+	if (cache[i].sector == sectorNumber) {
+	    cache[i].lastUsed = ++useCount;
+	    return &cache[i];
+	}
+    }
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Allocate
+// 	Hand the least recently used cache entry over to "sectorNumber",
+//	writing its old contents back first if they are dirty.  Entries
+//	being read ahead are not candidates.  The data is left for the
+//	caller to fill in.  Must be called with cacheLock held, and only
+//	for a sector that is not already cached.
+//----------------------------------------------------------------------
+
+CacheEntry *
+SynchDisk::Allocate(int sectorNumber)
+{
+    CacheEntry *victim = NULL;
+    int i;
+
+    for (i = 0; i < cacheSize; i++) {
+	if (!cache[i].loading && ((victim == NULL) 
+				|| (cache[i].lastUsed < victim->lastUsed)))
+	    victim = &cache[i];
+    }
+    ASSERT(victim != NULL);		// all being read ahead?
+    if (victim->dirty) {
+	DEBUG('d', "Cache evicting dirty sector %d\n", victim->sector);
+	DiskWrite(victim->sector, 1, victim->data);
+	victim->dirty = FALSE;
+    }
+    victim->sector = sectorNumber;
+    victim->lastUsed = ++useCount;
+    return victim;
 }
 
 //----------------------------------------------------------------------
 // SynchDisk::ReadSector
-// 	Read the contents of a disk sector into a buffer.  Return only
-//	after the data has been read.
+// 	Read the contents of a disk sector into a buffer, from the cache
+//	if it is there.  Return only after the data has been read.
 //
 //	"sectorNumber" -- the disk sector to read
 //	"data" -- the buffer to hold the contents of the disk sector
@@ -72,16 +322,14 @@ SynchDisk::~SynchDisk()
 void
 SynchDisk::ReadSector(int sectorNumber, char* data)
 {
-    lock->Acquire();			// only one disk I/O at a time
-    disk->ReadRequest(sectorNumber, data);
-    semaphore->P();			// wait for interrupt
-    lock->Release();
+    ReadSectors(sectorNumber, 1, data);
 }
 
 //----------------------------------------------------------------------
 // SynchDisk::WriteSector
-// 	Write the contents of a buffer into a disk sector.  Return only
-//	after the data has been written.
+// 	Write the contents of a buffer into a disk sector.  The sector
+//	is only updated in the cache; it reaches the disk when it is
+//	evicted or on Sync.
 //
 //	"sectorNumber" -- the disk sector to be written
 //	"data" -- the new contents of the disk sector
@@ -90,20 +338,341 @@ SynchDisk::ReadSector(int sectorNumber, char* data)
 void
 SynchDisk::WriteSector(int sectorNumber, char* data)
 {
-    lock->Acquire();			// only one disk I/O at a time
-    disk->WriteRequest(sectorNumber, data);
-    semaphore->P();			// wait for interrupt
-    lock->Release();
+    WriteSectors(sectorNumber, 1, data);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::ReadSectors
+// 	Read "count" consecutive sectors into "data", through the cache
+//	if there is one.  Sectors that the journal holds newer copies of
+//	are taken from the journal.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::ReadSectors(int firstSector, int count, char* data)
+{
+    int i;
+
+    if (cacheSize == 0)
+	DiskRead(firstSector, count, data);
+    else
+	CachedRead(firstSector, count, data);
+    if ((journal != NULL) && journal->Pending())
+	for (i = 0; i < count; i++)	// newer copies not yet committed
+	    journal->Find(firstSector + i, &data[i * SectorSize]);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::CachedRead
+// 	Read "count" consecutive sectors into "data" through the cache.
+//	Cached sectors are copied from the cache; each run of sectors
+//	that are not cached is read from the disk with one request
+//	straight into "data", and then cached.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::CachedRead(int firstSector, int count, char* data)
+{
+    CacheEntry *entry;
+    int i, run, writes;
+
+    cacheLock->P();
+    for (i = 0; i < count; i += run) {
+	entry = Lookup(firstSector + i);
+	if ((entry != NULL) && entry->loading) {
+	    // being read ahead; wait for it, then look again
+	    entry->waiters++;
+	    cacheLock->V();
+	    entry->loaded->P();
+	    cacheLock->P();
+	    run = 0;
+	    continue;
+	}
+	if (entry != NULL) {
+	    stats->numCacheHits++;
+	    bcopy(entry->data, &data[i * SectorSize], SectorSize);
+	    run = 1;
+	    continue;
+	}
+	for (run = 1; (i + run < count) && (Lookup(firstSector + i + run) == NULL); run++)
+	    ;
+	stats->numCacheMisses += run;
+
+	// let other threads use the cache, and queue their own disk
+	// requests, while we wait
+	writes = writeCount;
+	cacheLock->V();
+	DiskRead(firstSector + i, run, &data[i * SectorSize]);
+	cacheLock->P();
+
+	// cache what we read, unless it may have been overwritten
+	// meanwhile, or somebody else cached a copy first
+	if (writes != writeCount)
+	    continue;
+	for (int j = i; j < i + run; j++) {
+	    if (Lookup(firstSector + j) != NULL)
+		continue;
+	    entry = Allocate(firstSector + j);
+	    bcopy(&data[j * SectorSize], entry->data, SectorSize);
+	}
+    }
+    cacheLock->V();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::WriteSectors
+// 	Write "count" consecutive sectors from "data".  Normally they are
+//	only written into the cache.  A transfer too big to cache without
+//	flushing most of the cache goes to the disk in one request
+//	instead.
+//
+//	While the journal is capturing a file system operation, the
+//	sectors go into its transaction instead.  Otherwise, any older
+//	copy the transaction holds is dropped, since this write replaces
+//	it.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::WriteSectors(int firstSector, int count, char* data)
+{
+    CacheEntry *entry;
+    int i;
+
+    if (journal != NULL) {
+	for (i = 0; i < count; i++)
+	    if (journal->Capturing())
+		journal->Log(firstSector + i, &data[i * SectorSize]);
+	    else
+		journal->Forget(firstSector + i);
+	if (journal->Capturing())
+	    return;
+    }
+    if ((cacheSize == 0) || (count > cacheSize / 2)) {
+	WriteThrough(firstSector, count, data);
+	return;
+    }
+    cacheLock->P();
+    for (i = 0; i < count; i++) {
+	if ((entry = Lookup(firstSector + i)) == NULL)
+	    entry = Allocate(firstSector + i);	// whole sector, no need to read it
+	bcopy(&data[i * SectorSize], entry->data, SectorSize);
+	entry->dirty = TRUE;
+	if (entry->loading)
+	    Loaded(entry);		// the data read ahead is stale
+    }
+    cacheLock->V();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::WriteThrough
+// 	Write "count" consecutive sectors from "data" to the disk in one
+//	request, and update any cached copies of them.  Return only
+//	after the data has been written.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::WriteThrough(int firstSector, int count, char* data)
+{
+    CacheEntry *entry;
+    int i;
+
+    cacheLock->P();
+    DiskWrite(firstSector, count, data);
+    for (i = 0; i < count; i++) {
+	if ((entry = Lookup(firstSector + i)) != NULL) {
+	    bcopy(&data[i * SectorSize], entry->data, SectorSize);
+	    entry->dirty = FALSE;
+	    if (entry->loading)
+		Loaded(entry);
+	}
+    }
+    cacheLock->V();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Sync
+// 	Write every dirty sector in the cache back to the disk.  Dirty
+//	sectors that are consecutive on the disk are written with one
+//	request: the dirty entries are sorted by sector, to find the runs.
+//	Writing back is not a use, so the LRU order is left alone.
+//
+//	"halting" -- Nachos is shutting down, so nobody can wait for the
+//	   disk interrupt; finish whatever the disk is still working on,
+//	   then write the sectors out at once.  Any request made after
+//	   this, while the rest of Nachos shuts down, is also done at once.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Sync(bool halting)
+{
+    CacheEntry **dirty;
+    char *buf;
+    int i, j, n, run;
+
+    if (halting) {
+	Drain();			// let the disk finish what it has,
+	ASSERT(numLoading == 0);	// read ahead included
+	halted = TRUE;
+    } else
+	cacheLock->P();
+    buf = new char[cacheSize * SectorSize];
+    dirty = new CacheEntry *[cacheSize];
+    for (i = 0, n = 0; i < cacheSize; i++) {
+	if ((cache[i].sector == -1) || !cache[i].dirty)
+	    continue;
+	for (j = n; (j > 0) && (dirty[j - 1]->sector > cache[i].sector); j--)
+	    dirty[j] = dirty[j - 1];	// insertion sort; the cache is small
+	dirty[j] = &cache[i];
+	n++;
+    }
+    for (i = 0; i < n; i += run) {
+	for (run = 0; (i + run < n)
+		&& (dirty[i + run]->sector == dirty[i]->sector + run); run++) {
+	    bcopy(dirty[i + run]->data, &buf[run * SectorSize], SectorSize);
+	    dirty[i + run]->dirty = FALSE;
+	}
+	DiskWrite(dirty[i]->sector, run, buf);
+    }
+    delete [] dirty;
+    delete [] buf;
+    if (!halting)
+	cacheLock->V();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Flush
+// 	Write back all dirty sectors and then forget every cached sector,
+//	so that the following requests all go to the disk.  Sectors still
+//	being read ahead are kept.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Flush()
+{
+    int i;
+
+    Sync(FALSE);
+    cacheLock->P();
+    for (i = 0; i < cacheSize; i++)
+	if (!cache[i].loading)
+	    cache[i].sector = -1;
+    cacheLock->V();
 }
 
 //----------------------------------------------------------------------
 // SynchDisk::RequestDone
-// 	Disk interrupt handler.  Wake up any thread waiting for the disk
-//	request to finish.
+// 	Disk interrupt handler.  Wake up the thread waiting for the
+//	request that just finished, and start the next one.
 //----------------------------------------------------------------------
 
 void
 SynchDisk::RequestDone()
 { 
-    semaphore->V();
+    DiskRequest *finished = current;
+
+    current = NULL;
+    StartNext();
+    if (finished->done == NULL)
+	PrefetchDone(finished);
+    else
+	finished->done->V();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Prefetch
+// 	Start reading sectors into the cache, and return without waiting.
+//	Sectors already cached are skipped at the start; the run of
+//	sectors after them that are not cached is read with one request,
+//	into entries marked as loading.  At most a quarter of the cache
+//	is read ahead by one call, and half of it in all, so that files
+//	read ahead side by side always leave entries for Allocate to
+//	hand out.
+//
+//	This is only a hint, and does nothing if read ahead is turned
+//	off, there is no cache, or Nachos is halting.
+//
+//	"firstSector" -- the first disk sector to read
+//	"count" -- how many sectors
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Prefetch(int firstSector, int count)
+{
+    DiskRequest *request;
+    CacheEntry *entry;
+    int run;
+
+    if (!readAhead || halted || (cacheSize < 4))
+	return;
+    count = min(count, min(cacheSize / 4, NumSectors - firstSector));
+    cacheLock->P();
+    while ((count > 0) && (Lookup(firstSector) != NULL)) {
+	firstSector++;
+	count--;
+    }
+    count = min(count, cacheSize / 2 - numLoading);
+    request = new DiskRequest;
+    for (run = 0; (run < count) && (Lookup(firstSector + run) == NULL); run++) {
+	entry = Allocate(firstSector + run);
+	entry->loading = TRUE;
+	entry->loader = request;
+	numLoading++;
+    }
+    cacheLock->V();
+    if (run == 0) {
+	delete request;
+	return;
+    }
+
+    DEBUG('d', "Reading ahead %d sectors at %d\n", run, firstSector);
+    stats->numReadAheads += run;
+    request->firstSector = firstSector;
+    request->count = run;
+    request->data = new char[run * SectorSize];
+    request->writing = FALSE;
+    request->done = NULL;
+    Queue(request);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::PrefetchDone
+// 	Called by the interrupt handler when a read ahead completes.  Copy
+//	the sectors into the entries set aside for this request, unless
+//	they have been written meanwhile.  An entry that was written and
+//	then handed to a later read ahead of the same sector belongs to
+//	that request now, and is left for it.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::PrefetchDone(DiskRequest *request)
+{
+    CacheEntry *entry;
+
+    for (int i = 0; i < request->count; i++) {
+	entry = Lookup(request->firstSector + i);
+	if ((entry != NULL) && (entry->loader == request)) {
+	    bcopy(&request->data[i * SectorSize], entry->data, SectorSize);
+	    Loaded(entry);
+	}
+    }
+    delete [] request->data;
+    delete request;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Loaded
+// 	Mark an entry that was being read ahead as holding its data, and
+//	wake up the threads waiting for it.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Loaded(CacheEntry *entry)
+{
+    entry->loading = FALSE;
+    entry->loader = NULL;
+    numLoading--;
+    while (entry->waiters > 0) {
+	entry->waiters--;
+	entry->loaded->V();
+    }
 }
@@ -14,6 +14,8 @@
 #include "disk.h"
 #include "synch.h"
 
+class Journal;
+
 // The following class defines a "synchronous" disk abstraction.
 // As with other I/O devices, the raw physical disk is an asynchronous device --
 // requests to read or write portions of the disk return immediately,
@@ -23,31 +25,163 @@
 //
 // This class provides the abstraction that for any individual thread
 // making a request, it waits around until the operation finishes before
-// returning.
+// returning.  Requests from different threads are queued, and each time
+// the disk finishes one the next is picked by the scheduling policy:
+// either first come first served, or a C-LOOK elevator that sweeps the
+// head towards higher tracks and then jumps back to the lowest waiting
+// track.  Each request has its own semaphore, so only the thread whose
+// request completed is woken up.
+//
+// Recently used sectors are kept in a write-back cache, so that
+// rereading a file header, directory or data sector does not go to
+// the disk each time.  Sectors written are only written to the disk
+// when they are evicted, or on Sync.
+//
+// Sectors can also be read ahead of time, with Prefetch.  This queues
+// a request that nobody waits for; cache entries are set aside for the
+// sectors, and filled in by the interrupt handler when the request
+// completes.  A thread that wants one of them meanwhile waits for
+// that, rather than reading it again.
+//
+// While the file system is in the middle of an operation, the sectors
+// it writes are handed to the journal instead (cf. journal.h), and
+// reads of them are answered from there until the journal commits.
+
+#define DefaultCacheSectors	32	// size of the sector cache, if not
+					// given with -bc
+
+enum DiskPolicy { DiskFIFO, DiskCLook };
+
+// A queued disk request, owned by the thread waiting for it.
+
+typedef struct DiskRequest {
+    int firstSector;			// run of sectors to transfer
+    int count;
+    char *data;
+    bool writing;
+    Semaphore *done;			// V'ed when the transfer completes;
+					// NULL for a read ahead
+    struct DiskRequest *next;		// next in the waiting queue
+} DiskRequest;
+
+typedef struct {
+    int sector;				// which sector, -1 if the entry is free
+    bool dirty;				// modified since read from the disk?
+    bool loading;			// being read ahead?
+    DiskRequest *loader;		// the read ahead filling it in, if so
+    int waiters;			// threads waiting for it to be read
+    Semaphore *loaded;			// V'ed for each of them once it is
+    int lastUsed;			// for LRU replacement
+    char data[SectorSize];
+} CacheEntry;
+
 class SynchDisk {
   public:
-    SynchDisk(char* name);    		// Initialize a synchronous disk,
-					// by initializing the raw Disk.
+    SynchDisk(char* name, int cacheSectors);
+    					// Initialize a synchronous disk,
+					// by initializing the raw Disk,
+					// with a cache of "cacheSectors"
+					// sectors (0 for none).
     ~SynchDisk();			// De-allocate the synch disk data
     
     void ReadSector(int sectorNumber, char* data);
     					// Read/write a disk sector, returning
     					// only once the data is actually read 
-					// or written.  These call
-    					// Disk::ReadRequest/WriteRequest and
-					// then wait until the request is done.
+					// or written.  These queue a
+    					// request for the disk and then
+					// wait until it is done.
     void WriteSector(int sectorNumber, char* data);
+
+    void ReadSectors(int firstSector, int count, char* data);
+    void WriteSectors(int firstSector, int count, char* data);
+    					// Same, for "count" sectors that are
+					// consecutive on the disk.  Sectors
+					// that must go to the disk are
+					// transferred in as few requests as
+					// possible.
+
+    void Prefetch(int firstSector, int count);
+					// Start reading sectors into the
+					// cache, without waiting for them
+
+    void WriteThrough(int firstSector, int count, char* data);
+					// Write sectors to the disk now, with
+					// one request, updating any cached
+					// copies
+
+    void Sync(bool halting);		// Write all dirty cached sectors back
+					// to the disk.  If "halting", there is
+					// no thread left to wait for the disk,
+					// so write them out immediately, and
+					// do so for any later request too.
+    
+    void Flush();			// Sync, then empty the cache
+
+    void SetPolicy(DiskPolicy p) { policy = p; }
+					// Choose how waiting requests are
+					// ordered
+
+    void SetReadAhead(bool on) { readAhead = on; }
+					// Turn Prefetch on or off
+
+    void SetJournal(Journal *j) { journal = j; }
+					// Log metadata writes in "j"
+
+    void CrashAfter(int writes) { crashCountdown = writes; }
+					// Simulate a crash during the
+					// "writes"th disk write from now
     
     void RequestDone();			// Called by the disk device interrupt
 					// handler, to signal that the
-					// current disk operation is complete.
+					// current disk operation is complete,
+					// and start the next one.
 
   private:
     Disk *disk;		  		// Raw disk device
-    Semaphore *semaphore; 		// To synchronize requesting thread 
-					// with the interrupt handler
-    Lock *lock;		  		// Only one read/write request
-					// can be sent to the disk at a time
+    DiskPolicy policy;			// How to pick the next request
+    DiskRequest *current;		// The request the disk is working
+					// on, or NULL if it is idle
+    DiskRequest *waiting;		// Requests not yet sent to the disk,
+					// in order of arrival
+    int headTrack;			// Track the last request ended on
+    bool readAhead;			// Does Prefetch do anything?
+    bool halted;			// Nachos is halting; do requests
+					// at once, without interrupts
+    int writeCount;			// Bumped by every write, so a read
+					// that waited for the disk can tell
+					// whether its data may be stale
+    Journal *journal;			// Where metadata writes go, or NULL
+    int crashCountdown;			// Disk writes until a simulated
+					// crash, or 0 for none
+
+    CacheEntry *cache;			// The sector cache
+    int cacheSize;			// Number of entries in it
+    int numLoading;			// Entries being read ahead
+    int useCount;			// Clock for LRU replacement
+    Semaphore *cacheLock;		// Held by the thread using the cache;
+					// released while a miss is read
+
+    void DiskRead(int firstSector, int count, char* data);
+    void DiskWrite(int firstSector, int count, char* data);
+    					// Read/write sectors on the disk
+    void CachedRead(int firstSector, int count, char* data);
+					// Read sectors through the cache
+    void Transfer(int firstSector, int count, char* data, bool writing);
+					// Queue a request and wait for it
+    void Queue(DiskRequest *request);	// Add a request to the queue
+    void Drain();			// Wait, without blocking, for the
+					// disk to finish every request
+    void PrefetchDone(DiskRequest *request);
+					// Fill in the sectors read ahead
+    void Loaded(CacheEntry *entry);	// An entry being read ahead has
+					// its data; wake up its waiters
+    void StartNext();			// Send the next waiting request, if
+					// any, to the disk
+    CacheEntry *Lookup(int sectorNumber);
+					// Return the entry caching a sector,
+					// or NULL
+    CacheEntry *Allocate(int sectorNumber);
+					// Make room for a sector in the cache
 };
 
 #endif // SYNCHDISK_H
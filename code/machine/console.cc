@@ -7,6 +7,10 @@
 //	delay), to signal that a byte has arrived and/or that a written
 //	byte has departed.
 //
+//	Rather than poll the keyboard every ConsoleTime ticks, we ask the
+//	interrupt simulation to tell us when it has input, and only while
+//	the kernel is waiting for a character.
+//
 //  DO NOT CHANGE -- part of the machine emulation
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
@@ -54,9 +58,7 @@ Console::Console(char *readFile, char *writeFile, VoidFunctionPtr readAvail,
     handlerArg = callArg;
     putBusy = FALSE;
     incoming = EOF;
-
-    // start polling for incoming packets
-    interrupt->Schedule(ConsoleReadPoll, (int)this, ConsoleTime, ConsoleReadInt);
+    expecting = FALSE;		// nobody is reading yet
 }
 
 //----------------------------------------------------------------------
@@ -66,6 +68,7 @@ Console::Console(char *readFile, char *writeFile, VoidFunctionPtr readAvail,
 
 Console::~Console()
 {
+    interrupt->IgnoreInput(readFileNo);	// in case it is still watched
     if (readFileNo != 0)
 	Close(readFileNo);
     if (writeFileNo != 1)
@@ -74,13 +77,14 @@ Console::~Console()
 
 //----------------------------------------------------------------------
 // Console::CheckCharAvail()
-// 	Periodically called to check if a character is available for
-//	input from the simulated keyboard (eg, has it been typed?).
+// 	Called when the simulated keyboard has input (eg, a character has
+//	been typed), while the kernel is expecting a character.
 //
 //	Only read it in if there is buffer space for it (if the previous
 //	character has been grabbed out of the buffer by the Nachos kernel).
 //	Invoke the "read" interrupt handler, once the character has been 
-//	put into the buffer. 
+//	put into the buffer.  The keyboard is not watched again until
+//	the next ExpectChar.
 //----------------------------------------------------------------------
 
 void
@@ -88,13 +92,14 @@ Console::CheckCharAvail()
 {
     char c;
 
-    // schedule the next time to poll for a packet
-    interrupt->Schedule(ConsoleReadPoll, (int)this, ConsoleTime, 
-			ConsoleReadInt);
-
-    // do nothing if character is already buffered, or none to be read
-    if ((incoming != EOF) || !PollFile(readFileNo))
+    expecting = FALSE;
+    // do nothing if character is already buffered
+    if (incoming != EOF)
 	return;	  
+    if (!PollFile(readFileNo)) {	// nothing to be read after all
+	ExpectChar();
+	return;
+    }
 
     // otherwise, read character and tell user about it
     Read(readFileNo, &c, sizeof(char));
@@ -133,6 +138,23 @@ Console::GetChar()
    return ch;
 }
 
+//----------------------------------------------------------------------
+// Console::ExpectChar()
+// 	Start watching the keyboard for the next character, unless one
+//	is already buffered (in which case "readHandler" has already
+//	been called for it).
+//----------------------------------------------------------------------
+
+void
+Console::ExpectChar()
+{
+    if ((incoming != EOF) || expecting)
+	return;
+    expecting = TRUE;
+    interrupt->WatchInput(readFileNo, ConsoleReadPoll, (int)this,
+					ConsoleReadInt);
+}
+
 //----------------------------------------------------------------------
 // Console::PutChar()
 // 	Write a character to the simulated display, schedule an interrupt 
@@ -34,6 +34,10 @@
 // is called when a character has arrived, ready to be read in.
 // The interrupt handler "writeDone" is called when an output character 
 // has been "put", so that the next character can be written.
+//
+// The keyboard is only watched for input after a call to ExpectChar,
+// and until the next character arrives; so a console that nobody is
+// reading from costs nothing, and does not keep Nachos from idling.
 
 class Console {
   public:
@@ -52,6 +56,9 @@ class Console {
     				// "readHandler" is called whenever there is 
 				// a char to be gotten
 
+    void ExpectChar();		// Watch for the next char to be typed.
+				// Call before waiting for "readHandler".
+
 // internal emulation routines -- DO NOT call these. 
     void WriteDone();	 	// internal routines to signal I/O completion
     void CheckCharAvail();
@@ -70,6 +77,7 @@ class Console {
     char incoming;    			// Contains the character to be read,
 					// if there is one available. 
 					// Otherwise contains EOF.
+    bool expecting;			// Is the keyboard being watched?
 };
 
 #endif // CONSOLE_H
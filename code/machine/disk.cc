@@ -115,43 +115,105 @@ PrintSector (bool writing, int sector, char *data)
 void
 Disk::ReadRequest(int sectorNumber, char* data)
 {
-    int ticks = ComputeLatency(sectorNumber, FALSE);
+    ReadSectors(sectorNumber, 1, data);
+}
+
+void
+Disk::WriteRequest(int sectorNumber, char* data)
+{
+    WriteSectors(sectorNumber, 1, data);
+}
+
+//----------------------------------------------------------------------
+// Disk::ReadSectors/WriteSectors
+// 	Like ReadRequest/WriteRequest, but transfer "count" consecutive
+//	sectors starting at "firstSector" in one request.  The head seeks
+//	once and then streams the sectors, so this is much cheaper than
+//	"count" separate requests.
+//
+//	"data" -- the count*SectorSize bytes to be written, or the buffer
+//	   to hold the incoming bytes
+//----------------------------------------------------------------------
+
+void
+Disk::ReadSectors(int firstSector, int count, char* data)
+{
+    int ticks = ComputeLatency(firstSector, count, FALSE);
+    int rotation;
 
     ASSERT(!active);				// only one request at a time
-    ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
+    ASSERT((firstSector >= 0) && (count > 0) 
+		&& (firstSector + count <= NumSectors));
     
-    DEBUG('d', "Reading from sector %d\n", sectorNumber);
-    Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
-    Read(fileno, data, SectorSize);
+    DEBUG('d', "Reading %d sectors from sector %d\n", count, firstSector);
+    Lseek(fileno, SectorSize * firstSector + MagicSize, 0);
+    Read(fileno, data, SectorSize * count);
     if (DebugIsEnabled('d'))
-	PrintSector(FALSE, sectorNumber, data);
+	for (int i = 0; i < count; i++)
+	    PrintSector(FALSE, firstSector + i, data + i * SectorSize);
     
     active = TRUE;
-    UpdateLast(sectorNumber);
+    stats->numDiskSeekTicks += TimeToSeek(firstSector, &rotation);
+    UpdateLast(firstSector + count - 1);
     stats->numDiskReads++;
     interrupt->Schedule(DiskDone, (int) this, ticks, DiskInt);
 }
 
 void
-Disk::WriteRequest(int sectorNumber, char* data)
+Disk::WriteSectors(int firstSector, int count, char* data)
 {
-    int ticks = ComputeLatency(sectorNumber, TRUE);
+    int ticks = ComputeLatency(firstSector, count, TRUE);
+    int rotation;
 
     ASSERT(!active);
-    ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
+    ASSERT((firstSector >= 0) && (count > 0) 
+		&& (firstSector + count <= NumSectors));
     
-    DEBUG('d', "Writing to sector %d\n", sectorNumber);
-    Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
-    WriteFile(fileno, data, SectorSize);
+    DEBUG('d', "Writing %d sectors to sector %d\n", count, firstSector);
+    Lseek(fileno, SectorSize * firstSector + MagicSize, 0);
+    WriteFile(fileno, data, SectorSize * count);
     if (DebugIsEnabled('d'))
-	PrintSector(TRUE, sectorNumber, data);
+	for (int i = 0; i < count; i++)
+	    PrintSector(TRUE, firstSector + i, data + i * SectorSize);
     
     active = TRUE;
-    UpdateLast(sectorNumber);
+    stats->numDiskSeekTicks += TimeToSeek(firstSector, &rotation);
+    UpdateLast(firstSector + count - 1);
     stats->numDiskWrites++;
     interrupt->Schedule(DiskDone, (int) this, ticks, DiskInt);
 }
 
+//----------------------------------------------------------------------
+// Disk::ReadNow/WriteNow
+// 	Read/write a sector straight from/to the UNIX file, with no
+//	interrupt.  Used when Nachos is halting and no thread is left to
+//	wait for one.
+//----------------------------------------------------------------------
+
+void
+Disk::ReadNow(int sectorNumber, char* data)
+{
+    ASSERT(!active);
+    ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
+
+    DEBUG('d', "Reading from sector %d at halt\n", sectorNumber);
+    Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
+    Read(fileno, data, SectorSize);
+    stats->numDiskReads++;
+}
+
+void
+Disk::WriteNow(int sectorNumber, char* data)
+{
+    ASSERT(!active);
+    ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
+
+    DEBUG('d', "Writing to sector %d at halt\n", sectorNumber);
+    Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
+    WriteFile(fileno, data, SectorSize);
+    stats->numDiskWrites++;
+}
+
 //----------------------------------------------------------------------
 // Disk::HandleInterrupt()
 // 	Called when it is time to invoke the disk interrupt handler,
@@ -252,6 +314,23 @@ Disk::ComputeLatency(int newSector, bool writing)
     return(seek + rotation + RotationTime);
 }
 
+//----------------------------------------------------------------------
+// Disk::ComputeLatency()
+// 	Return how long it will take to transfer "count" consecutive
+//	sectors: the latency of the first, then one rotation for each
+//	further sector, plus a one track seek each time the run crosses
+//	onto the next track.
+//----------------------------------------------------------------------
+
+int
+Disk::ComputeLatency(int firstSector, int count, bool writing)
+{
+    int endSector = firstSector + count - 1;
+
+    return ComputeLatency(firstSector, writing) + (count - 1) * RotationTime
+	+ (endSector / SectorsPerTrack - firstSector / SectorsPerTrack) * SeekTime;
+}
+
 //----------------------------------------------------------------------
 // Disk::UpdateLast
 //   	Keep track of the most recently requested sector.  So we can know
@@ -67,6 +67,20 @@ class Disk {
     					// Only one request allowed at a time!
     void WriteRequest(int sectorNumber, char* data);
 
+    void ReadSectors(int firstSector, int count, char* data);
+    void WriteSectors(int firstSector, int count, char* data);
+    					// Read/write "count" consecutive
+					// sectors as a single request, paying
+					// for one seek and then one rotation
+					// per sector.
+
+    void ReadNow(int sectorNumber, char* data);
+    void WriteNow(int sectorNumber, char* data);
+    					// Read/write a sector without
+					// simulating its latency; only for
+					// flushing buffered data when Nachos
+					// halts.
+
     void HandleInterrupt();		// Interrupt handler, invoked when
 					// disk request finishes.
 
@@ -74,6 +88,8 @@ class Disk {
     					// Return how long a request to 
 					// newSector will take: 
 					// (seek + rotational delay + transfer)
+    int ComputeLatency(int firstSector, int count, bool writing);
+					// Same, for "count" sectors
 
   private:
     int fileno;				// UNIX file number for simulated disk 
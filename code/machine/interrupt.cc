@@ -28,7 +28,8 @@
 
 static char *intLevelNames[] = { "off", "on"};
 static char *intTypeNames[] = { "timer", "disk", "console write", 
-			"console read", "network send", "network recv"};
+			"console read", "network send", "network recv",
+			"network timeout"};
 
 //----------------------------------------------------------------------
 // PendingInterrupt::PendingInterrupt
@@ -64,6 +65,8 @@ Interrupt::Interrupt()
     inHandler = FALSE;
     yieldOnReturn = FALSE;
     status = SystemMode;
+    numWatches = 0;
+    nextInputCheck = 0;
 }
 
 //----------------------------------------------------------------------
@@ -162,6 +165,12 @@ Interrupt::OneTick()
     }
     DEBUG('i', "\n== Tick %d ==\n", stats->totalTicks);
 
+// every so often, see if the host has any input for the devices
+    if ((numWatches > 0) && (stats->totalTicks >= nextInputCheck)) {
+	nextInputCheck = stats->totalTicks + InputCheckTime;
+	(void) CheckInputs(0);
+    }
+
 // check any pending interrupts are now ready to fire
     ChangeLevel(IntOn, IntOff);		// first, turn off interrupts
 					// (interrupt handlers run with
@@ -204,15 +213,28 @@ Interrupt::YieldOnReturn()
 //	on the ready queue, the only thing to do is to advance 
 //	simulated time until the next scheduled hardware interrupt.
 //
-//	If there are no pending interrupts, stop.  There's nothing
-//	more for us to do.
+//	If there are no pending interrupts, but a device is waiting for
+//	input from the host, sleep until the input arrives.  Otherwise,
+//	stop.  There's nothing more for us to do.
+//
+//	Advancing the clock to a network timeout would fire it right away,
+//	however long the other machine actually takes to answer, so first
+//	give any answer a moment to arrive.
 //----------------------------------------------------------------------
 void
 Interrupt::Idle()
 {
+    PendingInterrupt *next = NULL;
+
     DEBUG('i', "Machine idling; checking for interrupts.\n");
     status = IdleMode;
-    if (CheckIfDue(TRUE)) {		// check for any pending interrupts
+    if (!pending->IsEmpty())
+	next = (PendingInterrupt *) pending->GetFirst()->item;
+    (void) CheckInputs((next != NULL && next->type == NetworkTimeoutInt) ?
+				TimeoutGrace : 0);
+					// any input since the last check?
+    if (CheckIfDue(TRUE) 		// check for any pending interrupts
+	    || (CheckInputs(-1) && CheckIfDue(TRUE))) {
     	while (CheckIfDue(FALSE))	// check for any other pending 
 	    ;				// interrupts
         yieldOnReturn = FALSE;		// since there's nothing in the
@@ -224,8 +246,8 @@ Interrupt::Idle()
 
     // if there are no pending interrupts, and nothing is on the ready
     // queue, it is time to stop.   If the console or the network is 
-    // operating, there are *always* pending interrupts, so this code
-    // is not reached.  Instead, the halt must be invoked by the user program.
+    // waiting for input, we sleep above instead, so this code is not
+    // reached.  Instead, the halt must be invoked by the user program.
 
     DEBUG('i', "Machine idle.  No interrupts to do.\n");
     printf("No threads ready or runnable, and no pending interrupts.\n");
@@ -240,9 +262,8 @@ Interrupt::Idle()
 void
 Interrupt::Halt()
 {
-    int max_completion=0, min_completion=stats->totalTicks, total_completion=0;
-    float avg_completion, var_completion=0;
-    unsigned i;
+    int max_completion=0, min_completion=stats->totalTicks;
+    float avg_completion, var_completion;
 
     printf("Machine halting!\n\n");
     stats->Print();
@@ -251,47 +272,19 @@ Interrupt::Halt()
        printf("Error in burst estimate over average burst length: %.2f\n", ((float)stats->burstEstimateError)/stats->cpu_time);
     }
 
+    threadTable->CompletionStatistics(excludeMainThread, &max_completion, &min_completion,
+                                      &avg_completion, &var_completion);
     if (excludeMainThread) {
-       for (i=1; i<thread_index; i++) {
-          if (exitThreadArray[i]) {
-             ASSERT(completionTimeArray[i] != -1);
-             total_completion += completionTimeArray[i];
-             if (completionTimeArray[i] > max_completion) max_completion = completionTimeArray[i];
-             if (completionTimeArray[i] < min_completion) min_completion = completionTimeArray[i];
-          }
-       }
-
-       avg_completion = (float)total_completion/(thread_index-1);
-    
-       for (i=1; i<thread_index; i++) {
-          var_completion += ((completionTimeArray[i] - avg_completion)*(completionTimeArray[i] - avg_completion));
-       }
-
-       var_completion = var_completion/(thread_index-1);
-
        printf("Completion time statistics for all but main thread: Max: %d, Min: %d, Avg: %.2f, Variance: %.2f\n", max_completion, min_completion, avg_completion, var_completion);
     }
     else {
-       for (i=0; i<thread_index; i++) {
-          if (exitThreadArray[i]) {
-             ASSERT(completionTimeArray[i] != -1);
-             total_completion += completionTimeArray[i];
-             if (completionTimeArray[i] > max_completion) max_completion = completionTimeArray[i];
-             if (completionTimeArray[i] < min_completion) min_completion = completionTimeArray[i];
-          }
-       }
-
-       avg_completion = (float)total_completion/thread_index;
-
-       for (i=1; i<thread_index; i++) {
-          var_completion += ((completionTimeArray[i] - avg_completion)*(completionTimeArray[i] - avg_completion));
-       }
-
-       var_completion = var_completion/thread_index;
-
        printf("Completion time statistics for all threads: Max: %d, Min: %d, Avg: %.2f, Variance: %.2f\n", max_completion, min_completion, avg_completion, var_completion);
     }
     printf("PageFaults :: %d\n", numPageFaults);
+#ifdef USER_PROGRAM
+    if (batchReportFd != -1)
+       ReportBatchInstance(max_completion, avg_completion);
+#endif
     Cleanup();     // Never returns.
 }
 
@@ -324,6 +317,88 @@ Interrupt::Schedule(VoidFunctionPtr handler, int arg, int fromNow, IntType type)
     pending->SortedInsert(toOccur, when);
 }
 
+//----------------------------------------------------------------------
+// Interrupt::WatchInput
+// 	Called by a device simulator that gets input from the host, to
+//	have "handler" called, as an interrupt of the given type, once
+//	host file "fd" has input.  The watch fires once; the device calls
+//	this again when it is ready for more input.
+//
+//	"fd" -- the host file or socket
+//	"handler", "arg", "type" -- the interrupt to cause
+//----------------------------------------------------------------------
+void
+Interrupt::WatchInput(int fd, VoidFunctionPtr handler, int arg, IntType type)
+{
+    InputWatch *watch = NULL;
+
+    for (int i = 0; i < numWatches; i++)
+	if (watches[i].fd == fd)
+	    watch = &watches[i];
+    if (watch == NULL) {
+	ASSERT(numWatches < MaxInputWatches);
+	watch = &watches[numWatches++];
+	watch->fd = fd;
+    }
+    watch->handler = handler;
+    watch->arg = arg;
+    watch->type = type;
+    watch->armed = TRUE;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::IgnoreInput
+// 	Stop watching host file "fd" for input.
+//----------------------------------------------------------------------
+void
+Interrupt::IgnoreInput(int fd)
+{
+    for (int i = 0; i < numWatches; i++)
+	if (watches[i].fd == fd) {
+	    watches[i] = watches[--numWatches];
+	    return;
+	}
+}
+
+//----------------------------------------------------------------------
+// Interrupt::CheckInputs
+// 	Check the host files that devices are waiting on, and schedule
+//	the interrupt of each one that has input, to occur on the next
+//	tick.  Return TRUE if any was scheduled.
+//
+//	"timeout" -- if no file has input, sleep up to this many host 
+//		milliseconds (or, if -1, until one does).  Nachos has
+//		nothing else to do, so simulated time doesn't move.
+//----------------------------------------------------------------------
+bool
+Interrupt::CheckInputs(int timeout)
+{
+    int fds[MaxInputWatches], which[MaxInputWatches];
+    bool ready[MaxInputWatches], any = FALSE;
+    int i, count = 0;
+
+    for (i = 0; i < numWatches; i++)
+	if (watches[i].armed) {
+	    which[count] = i;
+	    fds[count++] = watches[i].fd;
+	}
+    if (count == 0)
+	return FALSE;
+    if (timeout != 0)
+	DEBUG('i', "Machine idle; waiting for input.\n");
+    if (!WaitForFiles(fds, ready, count, timeout))
+	return FALSE;
+    for (i = 0; i < count; i++)
+	if (ready[i]) {
+	    InputWatch *watch = &watches[which[i]];
+
+	    watch->armed = FALSE;
+	    Schedule(watch->handler, watch->arg, 1, watch->type);
+	    any = TRUE;
+	}
+    return any;
+}
+
 //----------------------------------------------------------------------
 // Interrupt::CheckIfDue
 // 	Check if an interrupt is scheduled to occur, and if so, fire it off.
@@ -14,6 +14,12 @@
 //		a user instruction is executed
 //		there is nothing in the ready queue
 //
+//	Devices that get input from the host (the console and the
+//	network) ask to be told when a host file has input, rather than
+//	polling it.  The files are checked every InputCheckTime ticks,
+//	and when there is nothing to run, Nachos sleeps until one of
+//	them has input instead of spinning.
+//
 //	As a result, unlike real hardware, interrupts (and thus time-slice 
 //	context switches) cannot occur anywhere in the code where interrupts
 //	are enabled, but rather only at those places in the code where 
@@ -48,9 +54,10 @@ enum MachineStatus {IdleMode, SystemMode, UserMode};
 
 // IntType records which hardware device generated an interrupt.
 // In Nachos, we support a hardware timer device, a disk, a console
-// display and keyboard, and a network.
+// display and keyboard, and a network.  A network timeout is a timer
+// set by the network software, to retransmit lost packets.
 enum IntType { TimerInt, DiskInt, ConsoleWriteInt, ConsoleReadInt, 
-				NetworkSendInt, NetworkRecvInt};
+			NetworkSendInt, NetworkRecvInt, NetworkTimeoutInt};
 
 // The following class defines an interrupt that is scheduled
 // to occur in the future.  The internal data structures are
@@ -69,6 +76,23 @@ class PendingInterrupt {
     IntType type;		// for debugging
 };
 
+// A host file that a device wants to be told has input.
+
+#define MaxInputWatches	4
+
+// How long (in host milliseconds) an idle machine waits for input
+// before letting a network timeout go off.  The reply it is waiting for
+// may already be on its way from the other Nachos.
+#define TimeoutGrace	20
+
+typedef struct {
+    int fd;			// the host file
+    VoidFunctionPtr handler;	// interrupt to cause once it has input
+    int arg;
+    IntType type;
+    bool armed;			// still waiting for input?
+} InputWatch;
+
 // The following class defines the data structures for the simulation
 // of hardware interrupts.  We record whether interrupts are enabled
 // or disabled, and any hardware interrupts that are scheduled to occur
@@ -112,6 +136,12 @@ class Interrupt {
     
     void OneTick();       		// Advance simulated time
 
+    void WatchInput(int fd, VoidFunctionPtr handler, int arg, IntType type);
+					// Cause an interrupt the next time
+					// host file "fd" has input.  Called
+					// again to wait for more.
+    void IgnoreInput(int fd);		// Stop watching "fd"
+
   private:
     IntStatus level;		// are interrupts enabled or disabled?
     List *pending;		// the list of interrupts scheduled
@@ -120,6 +150,9 @@ class Interrupt {
     bool yieldOnReturn; 	// TRUE if we are to context switch
 				// on return from the interrupt handler
     MachineStatus status;	// idle, kernel mode, user mode
+    InputWatch watches[MaxInputWatches]; // host files being watched
+    int numWatches;
+    int nextInputCheck;		// when to look at them next
 
     // these functions are internal to the interrupt simulation code
 
@@ -128,6 +161,9 @@ class Interrupt {
 
     void ChangeLevel(IntStatus old, 	// SetLevel, without advancing the
 	IntStatus now);  		// simulated time
+    bool CheckInputs(int timeout);	// Schedule interrupts for watched
+					// files with input, waiting up to
+					// "timeout" ms (-1: forever) for some
 };
 
 #endif // INTERRRUPT_H
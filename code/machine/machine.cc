@@ -58,6 +58,7 @@ Machine::Machine(bool debug)
 
     for (i = 0; i < NumTotalRegs; i++)
         registers[i] = 0;
+    registersCopy = NULL;
     mainMemory = new char[MemorySize];
     for (i = 0; i < MemorySize; i++)
       	mainMemory[i] = 0;
@@ -211,5 +212,40 @@ void Machine::WriteRegister(int num, int value)
 	ASSERT((num >= 0) && (num < NumTotalRegs));
 	// DEBUG('m', "WriteRegister %d, value %d\n", num, value);
 	registers[num] = value;
+	registersCopy = NULL;
+    }
+
+//----------------------------------------------------------------------
+// Machine::SaveRegisters/RestoreRegisters/ForgetRegisters
+//   	Copy the whole register file out to, or back in from, a thread's
+//	save area in one go, for a context switch.
+//
+//	We remember which save area the registers were last copied to.
+//	If no other thread has loaded its registers, and the kernel has
+//	not written any, by the time that thread runs again, the registers
+//	are still right and RestoreRegisters does nothing.  User
+//	instructions change "registers" directly, but the running thread
+//	is always saved again before anyone else is restored.
+//----------------------------------------------------------------------
+
+void Machine::SaveRegisters(int *copy)
+    {
+	bcopy(registers, copy, sizeof(registers));
+	registersCopy = copy;
+    }
+
+bool Machine::RestoreRegisters(int *copy)
+    {
+	if (copy == registersCopy)
+	    return FALSE;
+	bcopy(copy, registers, sizeof(registers));
+	registersCopy = copy;
+	return TRUE;
+    }
+
+void Machine::ForgetRegisters(int *copy)
+    {
+	if (copy == registersCopy)
+	    registersCopy = NULL;
     }
 
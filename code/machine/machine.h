@@ -119,6 +119,12 @@ class Machine {
     void WriteRegister(int num, int value);
 				// store a value into a CPU register
 
+    void SaveRegisters(int *copy);	// copy out the whole register file
+    bool RestoreRegisters(int *copy);	// copy it back in, unless the
+					// registers still hold "copy";
+					// returns TRUE if it copied
+    void ForgetRegisters(int *copy);	// "copy" is being changed or freed
+
 
 // Routines internal to the machine simulation -- DO NOT call these 
 
@@ -161,6 +167,8 @@ class Machine {
 				// code and data, while executing
  
     int registers[NumTotalRegs]; // CPU registers, for executing user programs
+    int *registersCopy;		// saved copy the registers still match,
+				// or NULL
 
 
 // NOTE: the hardware translation of virtual addresses in the user program
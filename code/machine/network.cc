@@ -1,6 +1,8 @@
 // network.cc 
 //	Routines to simulate a network interface, using UNIX sockets
-//	to deliver packets between multiple invocations of nachos.
+//	to deliver packets between multiple invocations of nachos,
+//	or a Fabric to deliver them between machines simulated by
+//	a single one.
 //
 //  DO NOT CHANGE -- part of the machine emulation
 //
@@ -16,6 +18,8 @@ static void NetworkReadPoll(int arg)
 { Network *net = (Network *)arg; net->CheckPktAvail(); }
 static void NetworkSendDone(int arg)
 { Network *net = (Network *)arg; net->SendDone(); }
+static void FabricArrive(int arg)
+{ FabricPacket *packet = (FabricPacket *)arg; packet->fabric->Arrive(packet); }
 
 // Initialize the network emulation
 //   addr is used to generate the socket name
@@ -25,64 +29,104 @@ Network::Network(NetworkAddress addr, double reliability,
 	VoidFunctionPtr readAvail, VoidFunctionPtr writeDone, int callArg)
 {
     ident = addr;
-    if (reliability < 0) chanceToWork = 0;
-    else if (reliability > 1) chanceToWork = 1;
-    else chanceToWork = reliability;
+    SetReliability(reliability);
+    fabric = NULL;
 
     // set up the stuff to emulate asynchronous interrupts
     writeHandler = writeDone;
     readHandler = readAvail;
     handlerArg = callArg;
     sendBusy = FALSE;
-    inHdr.length = 0;
+    packetAvail = FALSE;
+    inbox = new char[MaxWireSize];
     
     sock = OpenSocket();
     sprintf(sockName, "SOCKET_%d", (int)addr);
     AssignNameToSocket(sockName, sock);		 // Bind socket to a filename 
 						 // in the current directory.
 
-    // start polling for incoming packets
-    interrupt->Schedule(NetworkReadPoll, (int)this, NetworkTime, NetworkRecvInt);
+    // wait for incoming packets
+    interrupt->WatchInput(sock, NetworkReadPoll, (int)this, NetworkRecvInt);
+}
+
+// Initialize the network emulation for a machine on a Fabric.  Our
+// own packets aren't dropped, unless SetReliability says so; the 
+// fabric's links drop them instead.
+Network::Network(NetworkAddress addr, Fabric *net,
+	VoidFunctionPtr readAvail, VoidFunctionPtr writeDone, int callArg)
+{
+    ident = addr;
+    chanceToWork = 1;
+    fabric = net;
+
+    writeHandler = writeDone;
+    readHandler = readAvail;
+    handlerArg = callArg;
+    sendBusy = FALSE;
+    packetAvail = FALSE;
+    inbox = new char[MaxWireSize];
+    sock = -1;
+
+    fabric->Attach(addr, this);
 }
 
 Network::~Network()
 {
-    CloseSocket(sock);
-    DeAssignNameToSocket(sockName);
+    if (fabric != NULL)
+	fabric->Detach(ident);
+    else {
+	interrupt->IgnoreInput(sock);
+	CloseSocket(sock);
+	DeAssignNameToSocket(sockName);
+    }
+    delete [] inbox;
 }
 
-// if a packet is already buffered, we simply delay reading 
-// the incoming packet.  In real life, the incoming 
+// called when the socket has input.  We stop watching the socket
+// while a packet is buffered, and so simply delay reading the next
+// incoming packet until Receive.  In real life, the incoming 
 // packet might be dropped if we can't read it in time.
 void
 Network::CheckPktAvail()
 {
-    // schedule the next time to poll for a packet
-    interrupt->Schedule(NetworkReadPoll, (int)this, NetworkTime, NetworkRecvInt);
+    PacketHeader *inHdr = (PacketHeader *) inbox;
 
-    if (inHdr.length != 0) 	// do nothing if packet is already buffered
+    if (packetAvail) 		// do nothing if packet is already buffered
 	return;		
-    if (!PollSocket(sock)) 	// do nothing if no packet to be read
-	return;
-
-    // otherwise, read packet in
-    char *buffer = new char[MaxWireSize];
-    ReadFromSocket(sock, buffer, MaxWireSize);
+    if (fabric != NULL) {
+	if (!fabric->Fetch(ident, inbox))
+	    return;		// nothing has arrived
+    } else {
+	if (!PollSocket(sock)) {	// nothing to be read after all
+	    interrupt->WatchInput(sock, NetworkReadPoll, (int)this, 
+					NetworkRecvInt);
+	    return;
+	}
 
-    // divide packet into header and data
-    inHdr = *(PacketHeader *)buffer;
-    ASSERT((inHdr.to == ident) && (inHdr.length <= MaxPacketSize));
-    bcopy(buffer + sizeof(PacketHeader), inbox, inHdr.length);
-    delete []buffer ;
+	// otherwise, read packet in, header and all
+	ReadFromSocket(sock, inbox, MaxWireSize);
+    }
+    ASSERT((inHdr->to == ident) && (inHdr->length <= MaxPacketSize));
+    packetAvail = TRUE;
 
     DEBUG('n', "Network received packet from %d, length %d...\n",
-	  				(int) inHdr.from, inHdr.length);
+	  				(int) inHdr->from, inHdr->length);
     stats->numPacketsRecvd++;
 
     // tell post office that the packet has arrived
     (*readHandler)(handlerArg);	
 }
 
+// change how likely packets we send are to get through, e.g. to
+// measure a protocol over links of different quality
+void
+Network::SetReliability(double reliability)
+{
+    if (reliability < 0) chanceToWork = 0;
+    else if (reliability > 1) chanceToWork = 1;
+    else chanceToWork = reliability;
+}
+
 // notify user that another packet can be sent
 void
 Network::SendDone()
@@ -115,6 +159,11 @@ Network::Send(PacketHeader hdr, char* data)
 	return;
     }
 
+    if (fabric != NULL) {
+	fabric->Carry(hdr, data);
+	return;
+    }
+
     // concatenate hdr and data into a single buffer, and send it out
     char *buffer = new char[MaxWireSize];
     *(PacketHeader *)buffer = hdr;
@@ -123,14 +172,168 @@ Network::Send(PacketHeader hdr, char* data)
     delete []buffer;
 }
 
-// read a packet, if one is buffered
-PacketHeader
-Network::Receive(char* data)
+// hand over the buffered packet, if there is one, without copying it;
+// the caller gives us another buffer in exchange
+char *
+Network::Receive(char *empty)
+{
+    char *full = inbox;
+
+    if (!packetAvail)
+	return NULL;
+    packetAvail = FALSE;
+    inbox = empty;
+    // room for the next packet
+    if (fabric == NULL)
+	interrupt->WatchInput(sock, NetworkReadPoll, (int)this, NetworkRecvInt);
+    else if (fabric->Waiting(ident))
+	interrupt->Schedule(NetworkReadPoll, (int)this, 1, NetworkRecvInt);
+    return full;
+}
+
+// connect "count" machines, each link with the given latency (in ticks)
+// and reliability
+Fabric::Fabric(int count, int latency, double reliability)
+{
+    int i;
+
+    numNodes = count;
+    latencies = new int[count * count];
+    reliabilities = new double[count * count];
+    for (i = 0; i < count * count; i++) {
+	latencies[i] = latency;
+	reliabilities[i] = reliability;
+    }
+    nodes = new Network *[count];
+    first = new FabricPacket *[count];
+    last = new FabricPacket *[count];
+    for (i = 0; i < count; i++) {
+	nodes[i] = NULL;
+	first[i] = last[i] = NULL;
+    }
+
+    packets = new FabricPacket[count * FabricBuffers];
+    freePackets = NULL;
+    for (i = 0; i < count * FabricBuffers; i++) {
+	packets[i].fabric = this;
+	packets[i].next = freePackets;
+	freePackets = &packets[i];
+    }
+}
+
+// packets still in flight are lost, so the Networks should be gone,
+// and nothing left on the wire, before the Fabric is
+Fabric::~Fabric()
+{
+    delete [] latencies;
+    delete [] reliabilities;
+    delete [] nodes;
+    delete [] first;
+    delete [] last;
+    delete [] packets;
+}
+
+// change one (one-way) link
+void
+Fabric::SetLink(NetworkAddress from, NetworkAddress to, int latency, 
+		double reliability)
+{
+    ASSERT((0 <= from) && (from < numNodes) && (0 <= to) && (to < numNodes));
+    latencies[from * numNodes + to] = latency;
+    reliabilities[from * numNodes + to] = reliability;
+}
+
+// plug in the Network for machine "addr"
+void
+Fabric::Attach(NetworkAddress addr, Network *net)
+{
+    ASSERT((0 <= addr) && (addr < numNodes) && (nodes[addr] == NULL));
+    nodes[addr] = net;
+}
+
+// unplug machine "addr"; whatever is waiting for it is thrown away
+void
+Fabric::Detach(NetworkAddress addr)
+{
+    FabricPacket *packet;
+
+    ASSERT((0 <= addr) && (addr < numNodes));
+    nodes[addr] = NULL;
+    while ((packet = first[addr]) != NULL) {
+	first[addr] = packet->next;
+	packet->next = freePackets;
+	freePackets = packet;
+    }
+    last[addr] = NULL;
+}
+
+// copy a packet into one of our buffers, and schedule its arrival at 
+// the other end of the link, unless the link drops it or we have no
+// room for it
+void
+Fabric::Carry(PacketHeader hdr, char *data)
 {
-    PacketHeader hdr = inHdr;
+    FabricPacket *packet;
+    int link;
 
-    inHdr.length = 0;
-    if (hdr.length != 0)
-    	bcopy(inbox, data, hdr.length);
-    return hdr;
+    ASSERT((0 <= hdr.to) && (hdr.to < numNodes));
+    link = hdr.from * numNodes + hdr.to;
+    if (Random() % 100 >= reliabilities[link] * 100) {
+	DEBUG('n', "lost on the link!\n");
+	return;
+    }
+    if ((packet = freePackets) == NULL) {
+	DEBUG('n', "switch full, dropped!\n");
+	return;
+    }
+    freePackets = packet->next;
+
+    *(PacketHeader *)packet->wire = hdr;
+    bcopy(data, packet->wire + sizeof(PacketHeader), hdr.length);
+    interrupt->Schedule(FabricArrive, (int)packet, max(latencies[link], 1), 
+				NetworkRecvInt);
+}
+
+// a packet has crossed its link; queue it for the receiving machine,
+// and tell its Network, in case it is ready for it
+void
+Fabric::Arrive(FabricPacket *packet)
+{
+    NetworkAddress to = ((PacketHeader *)packet->wire)->to;
+
+    if (nodes[to] == NULL) {		// nobody there
+	packet->next = freePackets;
+	freePackets = packet;
+	return;
+    }
+    packet->next = NULL;
+    if (last[to] == NULL)
+	first[to] = packet;
+    else
+	last[to]->next = packet;
+    last[to] = packet;
+    nodes[to]->CheckPktAvail();
+}
+
+// hand the oldest packet waiting for "addr" to its Network
+bool
+Fabric::Fetch(NetworkAddress addr, char *buffer)
+{
+    FabricPacket *packet = first[addr];
+
+    if (packet == NULL)
+	return FALSE;
+    first[addr] = packet->next;
+    if (first[addr] == NULL)
+	last[addr] = NULL;
+    bcopy(packet->wire, buffer, MaxWireSize);
+    packet->next = freePackets;
+    freePackets = packet;
+    return TRUE;
+}
+
+bool
+Fabric::Waiting(NetworkAddress addr)
+{
+    return (first[addr] != NULL);
 }
@@ -41,6 +41,8 @@ class PacketHeader {
 #define MaxPacketSize 	(MaxWireSize - sizeof(struct PacketHeader))	
 				// data "payload" of the largest packet
 
+class Fabric;
+
 
 // The following class defines a physical network device.  The network
 // is capable of delivering fixed sized packets, in order but unreliably, 
@@ -57,6 +59,11 @@ class Network {
     Network(NetworkAddress addr, double reliability,
   	  VoidFunctionPtr readAvail, VoidFunctionPtr writeDone, int callArg);
 				// Allocate and initialize network driver
+    Network(NetworkAddress addr, Fabric *net,
+  	  VoidFunctionPtr readAvail, VoidFunctionPtr writeDone, int callArg);
+				// Allocate and initialize a network driver
+				// for a machine on "net", simulated in this
+				// same Nachos
     ~Network();			// De-allocate the network driver data
     
     void Send(PacketHeader hdr, char* data);
@@ -69,20 +76,29 @@ class Network {
 				// the PacketHeader is filled in automatically 
 				// by Send().
 
-    PacketHeader Receive(char* data);
+    char *Receive(char *empty);
     				// Poll the network for incoming messages.  
-				// If there is a packet waiting, copy the 
-				// packet into "data" and return the header.
-				// If no packet is waiting, return a header 
-				// with length 0.
+				// If there is a packet waiting, return the
+				// buffer holding it, as it came off the 
+				// wire (PacketHeader, then data), and take
+				// the MaxWireSize buffer "empty" to read the
+				// next packet into.  If no packet is 
+				// waiting, return NULL.
+
+    void SetReliability(double reliability);
+				// Change the chance that a packet we 
+				// send gets through
 
     void SendDone();		// Interrupt handler, called when message is 
 				// sent
-    void CheckPktAvail();	// Check if there is an incoming packet
+    void CheckPktAvail();	// Called when the socket has input, to
+				// read in the incoming packet
 
   private:
     NetworkAddress ident;	// This machine's network address
     double chanceToWork;	// Likelihood packet will be dropped
+    Fabric *fabric;		// The Fabric we are attached to, or NULL
+				// if we talk to other Nachos over sockets
     int sock;			// UNIX socket number for incoming packets
     char sockName[32];		// File name corresponding to UNIX socket
     VoidFunctionPtr writeHandler; // Interrupt handler, signalling next packet 
@@ -94,8 +110,68 @@ class Network {
     bool sendBusy;		// Packet is being sent.
     bool packetAvail;		// Packet has arrived, can be pulled off of
 				//   network
-    PacketHeader inHdr;		// Information about arrived packet
-    char inbox[MaxPacketSize];  // Data for arrived packet
+    char *inbox;		// Buffer for the arriving packet
+};
+
+// The following class defines a switched network, connecting machines 
+// that are all simulated by the same Nachos.  Each machine's Network 
+// attaches to it, rather than to a UNIX socket, so a test can run as
+// many machines as it likes in one process.
+//
+// A packet takes "latency" ticks to cross the link from its sender to
+// its receiver, and gets through with probability "reliability"; both
+// can be set for each link.  Packets that have arrived wait in the 
+// switch until the receiving Network is ready for them.  Everything
+// happens in simulated time, so a run depends only on the random seed.
+
+#define FabricBuffers	16	// packets in flight, per machine attached;
+				// all machines share one pool of them,
+				// and the switch drops packets once it
+				// is used up
+
+class FabricPacket {
+  public:
+    Fabric *fabric;		// The switch carrying the packet
+    FabricPacket *next;		// Next packet waiting for the same machine
+    char wire[MaxWireSize];	// PacketHeader, then data
+};
+
+class Fabric {
+  public:
+    Fabric(int nodes, int latency, double reliability);
+				// Connect "nodes" machines, with every 
+				// link alike
+    ~Fabric();
+
+    void SetLink(NetworkAddress from, NetworkAddress to, int latency, 
+		double reliability);
+				// Change the link from "from" to "to"
+
+    void Attach(NetworkAddress addr, Network *net);
+    void Detach(NetworkAddress addr);
+				// Plug a Network into the switch, or pull
+				// it out
+
+    void Carry(PacketHeader hdr, char *data);
+				// Start a packet across its link
+    bool Fetch(NetworkAddress addr, char *buffer);
+				// Copy the next packet that has arrived for
+				// "addr" into "buffer", if there is one
+    bool Waiting(NetworkAddress addr);
+				// Are packets waiting for "addr"?
+    void Arrive(FabricPacket *packet);
+				// Interrupt handler, called when a packet 
+				// gets to the end of its link
+
+  private:
+    int numNodes;		// Machines on the switch
+    int *latencies;		// Link from i to j is at [i * numNodes + j]
+    double *reliabilities;
+    Network **nodes;		// Network attached at each address
+    FabricPacket *packets;	// All the packet buffers
+    FabricPacket *freePackets;	// Those not in use
+    FabricPacket **first;	// Packets waiting for each machine
+    FabricPacket **last;
 };
 
 #endif // NETWORK_H
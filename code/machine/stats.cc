@@ -20,8 +20,13 @@ Statistics::Statistics()
 {
     totalTicks = idleTicks = systemTicks = userTicks = 0;
     numDiskReads = numDiskWrites = 0;
+    numCacheHits = numCacheMisses = numReadAheads = 0;
+    numDiskSeekTicks = 0;
     numConsoleCharsRead = numConsoleCharsWritten = 0;
-    numPageFaults = numPacketsSent = numPacketsRecvd = 0;
+    numPageFaults = numPacketsSent = numPacketsRecvd = numRetransmits = 0;
+    numStacksAllocated = numStacksReused = 0;
+    numRegisterLoads = numRegisterLoadsSkipped = 0;
+    numSpaceLoads = numSpaceLoadsSkipped = 0;
     
     total_wait_time = 0;
     cpu_time = 0;
@@ -47,12 +52,20 @@ Statistics::Print()
 {
     printf("Ticks: total %d, idle %d, system %d, user %d\n", totalTicks, 
 	idleTicks, systemTicks, userTicks);
-    printf("Disk I/O: reads %d, writes %d\n", numDiskReads, numDiskWrites);
+    printf("Disk I/O: reads %d, writes %d, seek ticks %d\n", numDiskReads,
+	numDiskWrites, numDiskSeekTicks);
+    printf("Disk cache: hits %d, misses %d, read ahead %d\n", numCacheHits,
+	numCacheMisses, numReadAheads);
     printf("Console I/O: reads %d, writes %d\n", numConsoleCharsRead, 
 	numConsoleCharsWritten);
     printf("Paging: faults %d\n", numPageFaults);
-    printf("Network I/O: packets received %d, sent %d\n", numPacketsRecvd, 
-	numPacketsSent);
+    printf("Thread stacks: allocated %d, reused %d\n", numStacksAllocated,
+	numStacksReused);
+    printf("User context switches: registers loaded %d, kept %d; "
+	"page tables loaded %d, kept %d\n", numRegisterLoads,
+	numRegisterLoadsSkipped, numSpaceLoads, numSpaceLoadsSkipped);
+    printf("Network I/O: packets received %d, sent %d, retransmitted %d\n",
+	numPacketsRecvd, numPacketsSent, numRetransmits);
 
     printf("\nTotal simulated ticks: %d\n", totalTicks - start_time);
     printf("Total CPU busy time: %d\n", cpu_time);
@@ -40,16 +40,28 @@ class Statistics {
     int nonpreemptive_switch;	// Non-preemptive context switch count
 
     int numTotalThreads;	// Total number of created threads
+    int numStacksAllocated;	// Thread stacks allocated from the host
+    int numStacksReused;	// Thread stacks reused from deleted threads
+    int numRegisterLoads;	// User register files copied in on a switch
+    int numRegisterLoadsSkipped;// ... or found still in the machine
+    int numSpaceLoads;		// Page tables loaded on a switch
+    int numSpaceLoadsSkipped;	// ... or found already loaded
 
     int burstEstimateError;	// Keeps track of the squared error in burst estimates
 
     int numDiskReads;		// number of disk read requests
     int numDiskWrites;		// number of disk write requests
+    int numCacheHits;		// number of sector cache hits
+    int numCacheMisses;		// number of sector cache misses
+    int numReadAheads;		// number of sectors read ahead
+    int numDiskSeekTicks;	// ticks spent moving the disk head
     int numConsoleCharsRead;	// number of characters read from the keyboard
     int numConsoleCharsWritten; // number of characters written to the display
     int numPageFaults;		// number of virtual memory page faults
     int numPacketsSent;		// number of packets sent over the network
     int numPacketsRecvd;	// number of packets received over the network
+    int numRetransmits;		// number of packets sent again because
+				// they weren't acknowledged in time
 
     Statistics(); 		// initialize everything to zero
 
@@ -70,6 +82,8 @@ class Statistics {
 #define SeekTime 	500    	// time disk takes to seek past one track
 #define ConsoleTime 	100	// time to read or write one character
 #define NetworkTime 	100   	// time to send or receive one packet
+#define InputCheckTime	1000	// how often host input for the devices
+				// is looked for, when not idle
 #define TimerTicks 	100   	// (average) time between timer interrupts
 
 #endif // STATS_H
@@ -43,8 +43,10 @@ extern "C" {
 #endif
 
 #include <unistd.h>    // for getpagesize()
+#include <sys/wait.h>  // for wait()
 #include <stdlib.h>    // for exit()
 #include <errno.h>
+#include <poll.h>
 
 
 // UNIX routines called by procedures in this file 
@@ -138,6 +140,44 @@ PollFile(int fd)
     return TRUE;
 }
 
+//----------------------------------------------------------------------
+// WaitForFiles
+// 	Check a set of open files or sockets for characters that can be
+//	read, setting "ready[i]" for each "fds[i]" that has some.  Return
+//	TRUE if any does.
+//
+//	Unlike PollFile, this can block until one of the files has input.
+//	That is how Nachos waits for input when it has nothing else to
+//	do, without using the host CPU.
+//
+//	"fds" -- the file descriptors to check
+//	"ready" -- set to which of them have input
+//	"count" -- how many there are
+//	"timeout" -- milliseconds to wait for some input; 0 means don't 
+//		wait, -1 means wait as long as it takes
+//----------------------------------------------------------------------
+
+bool
+WaitForFiles(int *fds, bool *ready, int count, int timeout)
+{
+    struct pollfd *pfds = new struct pollfd[count];
+    int i, retVal;
+
+    for (i = 0; i < count; i++) {
+	pfds[i].fd = fds[i];
+	pfds[i].events = POLLIN;
+	pfds[i].revents = 0;
+    }
+    do {
+	retVal = poll(pfds, count, timeout);
+    } while ((retVal < 0) && (errno == EINTR));
+    ASSERT(retVal >= 0);
+    for (i = 0; i < count; i++)
+	ready[i] = (pfds[i].revents & (POLLIN | POLLHUP | POLLERR)) != 0;
+    delete [] pfds;
+    return (retVal > 0);
+}
+
 //----------------------------------------------------------------------
 // OpenForWrite
 // 	Open a file for writing.  Create it if it doesn't exist; truncate it 
@@ -367,7 +407,8 @@ ReadFromSocket(int sockID, char *buffer, int packetSize)
 //----------------------------------------------------------------------
 // SendToSocket
 // 	Transmit a fixed size packet to another Nachos' IPC port.
-//	Abort on error.
+//	If that Nachos isn't running, the packet is lost, as it would be
+//	on a real network.  Abort on any other error.
 //----------------------------------------------------------------------
 void
 SendToSocket(int sockID, char *buffer, int packetSize, char *toName)
@@ -378,6 +419,8 @@ SendToSocket(int sockID, char *buffer, int packetSize, char *toName)
     InitSocketName(&uName, toName);
     retVal = sendto(sockID, buffer, packetSize, 0,
 			  (sockaddr *) &uName, sizeof(uName));
+    if ((retVal < 0) && ((errno == ENOENT) || (errno == ECONNREFUSED)))
+	return;
     ASSERT(retVal == packetSize);
 }
 
@@ -429,6 +472,94 @@ Exit(int exitCode)
     exit(exitCode);
 }
 
+//----------------------------------------------------------------------
+// StartChildProcess
+// 	Fork a copy of the running Nachos, including the whole simulated
+//	machine.  Returns 0 in the child and the host pid in the parent.
+//	Buffered output is flushed first so the child does not repeat it.
+//----------------------------------------------------------------------
+
+int
+StartChildProcess()
+{
+    int pid;
+
+    fflush(stdout);
+    fflush(stderr);
+    pid = fork();
+    ASSERT(pid >= 0);
+    return pid;
+}
+
+//----------------------------------------------------------------------
+// WaitForChildProcess
+// 	Wait for any child started by StartChildProcess to exit.  Returns
+//	its exit code, or -1 if there are no children left or it died
+//	abnormally.
+//----------------------------------------------------------------------
+
+int
+WaitForChildProcess()
+{
+    int status;
+
+    if (wait(&status) == -1)
+	return -1;
+    if (!WIFEXITED(status))
+	return -1;
+    return WEXITSTATUS(status);
+}
+
+//----------------------------------------------------------------------
+// PollChildProcess
+// 	Like WaitForChildProcess, but return FALSE at once if no child
+//	has exited yet.  Otherwise set "exitCode" as WaitForChildProcess
+//	would return it, and return TRUE.
+//----------------------------------------------------------------------
+
+bool
+PollChildProcess(int *exitCode)
+{
+    int status, pid;
+
+    pid = waitpid(-1, &status, WNOHANG);
+    if (pid == 0)
+	return FALSE;
+    if ((pid == -1) || !WIFEXITED(status))
+	*exitCode = -1;
+    else
+	*exitCode = WEXITSTATUS(status);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// OpenPipe
+// 	Create a UNIX pipe; fds[0] is the read end and fds[1] the write
+//	end, for use with ReadPartial and WriteFile.
+//----------------------------------------------------------------------
+
+void
+OpenPipe(int fds[2])
+{
+    int retVal = pipe(fds);
+    ASSERT(retVal == 0);
+}
+
+//----------------------------------------------------------------------
+// DiscardOutput
+// 	Throw away anything this process prints from now on.
+//----------------------------------------------------------------------
+
+void
+DiscardOutput()
+{
+    FILE *out;
+
+    fflush(stdout);
+    out = freopen("/dev/null", "w", stdout);
+    ASSERT(out != NULL);
+}
+
 //----------------------------------------------------------------------
 // RandomInit
 // 	Initialize the pseudo-random number generator.  We use the
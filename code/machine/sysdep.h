@@ -17,6 +17,10 @@
 // If no characters in the file, return without waiting.
 extern bool PollFile(int fd);
 
+// Check several files at once, setting ready[i] if fds[i] has input.
+// Wait up to "timeout" ms (-1: forever) until at least one of them does.
+extern bool WaitForFiles(int *fds, bool *ready, int count, int timeout);
+
 // File operations: open/read/write/lseek/close, and check for error
 // For simulating the disk and the console devices.
 extern int OpenForWrite(char *name);
@@ -43,6 +47,13 @@ extern void Abort();
 extern void Exit(int exitCode);
 extern void Delay(int seconds);
 
+// Host process control, for running independent simulations side by side
+extern int StartChildProcess();
+extern int WaitForChildProcess();
+extern bool PollChildProcess(int *exitCode);
+extern void OpenPipe(int fds[2]);
+extern void DiscardOutput();
+
 // Initialize system so that cleanUp routine is called when user hits ctl-C
 extern void CallOnUserAbort(VoidNoArgFunctionPtr cleanUp);
 
@@ -26,6 +26,8 @@
 // dummy function because C++ does not allow pointers to member functions
 static void TimerHandler(int arg)
 { Timer *p = (Timer *)arg; p->TimerExpired(); }
+static void AlarmHandler(int arg)
+{ Timer *p = (Timer *)arg; p->AlarmExpired(); }
 
 //----------------------------------------------------------------------
 // Timer::Timer
@@ -46,6 +48,7 @@ Timer::Timer(VoidFunctionPtr timerHandler, int callArg, bool doRandom)
     randomize = doRandom;
     handler = timerHandler;
     arg = callArg; 
+    alarmDue = -1;
 
     // schedule the first interrupt from the timer device
     interrupt->Schedule(TimerHandler, (int) this, TimeOfNextInterrupt(), 
@@ -69,6 +72,40 @@ Timer::TimerExpired()
     (*handler)(arg);
 }
 
+//----------------------------------------------------------------------
+// Timer::SetAlarm
+//      Program the one-shot alarm to call "alarmHandler" (with
+//	interrupts disabled) "fromNow" ticks from now.  Any earlier
+//	setting is forgotten.
+//----------------------------------------------------------------------
+void
+Timer::SetAlarm(VoidFunctionPtr alarmHandler, int callArg, int fromNow)
+{
+    ASSERT(fromNow > 0);
+    alarm = alarmHandler;
+    alarmArg = callArg;
+    alarmDue = stats->totalTicks + fromNow;
+    interrupt->Schedule(AlarmHandler, (int) this, fromNow, TimerInt);
+}
+
+//----------------------------------------------------------------------
+// Timer::AlarmExpired
+//      Routine to simulate the alarm interrupt.  Interrupts scheduled
+//	for settings that were since cancelled or replaced are ignored.
+//	Such an interrupt can arrive before or after the current setting
+//	falls due.  If the alarm has gone off or been cancelled since,
+//	it is not set; if it is still set, it is not yet due, unless
+//	both were set for the same tick, and then going off is right.
+//----------------------------------------------------------------------
+void
+Timer::AlarmExpired()
+{
+    if ((alarmDue == -1) || (stats->totalTicks < alarmDue))
+	return;
+    alarmDue = -1;
+    (*alarm)(alarmArg);
+}
+
 //----------------------------------------------------------------------
 // Timer::TimeOfNextInterrupt
 //      Return when the hardware timer device will next cause an interrupt.
@@ -11,6 +11,11 @@
 //	In order to introduce some randomness into time-slicing, if "doRandom"
 //	is set, then the interrupt comes after a random number of ticks.
 //
+//	The timer also has a one-shot alarm, which the kernel can program
+//	to interrupt after an exact number of ticks (for example, at the
+//	end of a time slice).  Re-programming the alarm cancels the
+//	previous setting.
+//
 //  DO NOT CHANGE -- part of the machine emulation
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
@@ -31,10 +36,17 @@ class Timer {
 				// handler "timerHandler" every time slice.
     ~Timer() {}
 
+    void SetAlarm(VoidFunctionPtr alarmHandler, int callArg, int fromNow);
+				// Call "alarmHandler" once, "fromNow"
+				// ticks from now
+    void CancelAlarm() { alarmDue = -1; }
+
 // Internal routines to the timer emulation -- DO NOT call these
 
     void TimerExpired();	// called internally when the hardware
 				// timer generates an interrupt
+    void AlarmExpired();	// called internally when the alarm
+				// goes off
 
     int TimeOfNextInterrupt();  // figure out when the timer will generate
 				// its next interrupt 
@@ -44,6 +56,10 @@ class Timer {
     VoidFunctionPtr handler;	// timer interrupt handler 
     int arg;			// argument to pass to interrupt handler
 
+    VoidFunctionPtr alarm;	// alarm interrupt handler
+    int alarmArg;		// argument to pass to it
+    int alarmDue;		// when the alarm is set for, -1 if not set
+
 };
 
 #endif // TIMER_H
@@ -70,3 +70,210 @@ MailTest(int farAddr)
     // Then we're done!
     interrupt->Halt();
 }
+
+// Test out sending messages too big for one piece of mail, the same way
+// as MailTest: send a message to "farAddr", wait for the other machine's
+// message, check that it arrived intact, and exchange acknowledgements.
+//	./nachos -m 0 -om 1 &
+//	./nachos -m 1 -om 0 &
+
+#define MessageSize	1000
+
+void
+MessageTest(int farAddr)
+{
+    PacketHeader outPktHdr, inPktHdr;
+    MailHeader outMailHdr, inMailHdr;
+    char *ack = "Got it!";
+    char *data = new char[MessageSize];
+    char *buffer = new char[MessageSize];
+    int i, length, errors = 0;
+
+    for (i = 0; i < MessageSize; i++)
+	data[i] = 'a' + i % 26;
+
+    outPktHdr.to = farAddr;		
+    outMailHdr.to = 0;
+    outMailHdr.from = 1;
+    outMailHdr.length = MessageSize;
+    postOffice->SendMessage(outPktHdr, outMailHdr, data); 
+
+    length = postOffice->ReceiveMessage(0, &inPktHdr, &inMailHdr, buffer,
+					MessageSize);
+    for (i = 0; i < length; i++)
+	if (buffer[i] != 'a' + i % 26)
+	    errors++;
+    printf("Got %d byte message from %d, box %d, %d bytes wrong\n", length, 
+		inPktHdr.from, inMailHdr.from, errors);
+    fflush(stdout);
+
+    outPktHdr.to = inPktHdr.from;
+    outMailHdr.to = inMailHdr.from;
+    outMailHdr.length = strlen(ack) + 1;
+    postOffice->SendMessage(outPktHdr, outMailHdr, ack); 
+
+    postOffice->ReceiveMessage(1, &inPktHdr, &inMailHdr, buffer, MessageSize);
+    printf("Got \"%s\" from %d, box %d\n",buffer,inPktHdr.from,inMailHdr.from);
+    fflush(stdout);
+
+    delete [] data;
+    delete [] buffer;
+    interrupt->Halt();
+}
+
+// Measure reliable delivery over networks of different quality.  Both
+// machines send each other ReliablePackets pieces of mail at each
+// reliability from 0.5 to 1.0, and check that the other's arrive in
+// order, none lost or repeated.  Throughput is in bytes of data 
+// delivered per 1000 ticks, counting both directions.
+//	./nachos -m 0 -or 1 &
+//	./nachos -m 1 -or 0 &
+
+#define ReliablePackets	200
+
+void
+ReliableTest(int farAddr)
+{
+    PacketHeader outPktHdr, inPktHdr;
+    MailHeader outMailHdr, inMailHdr;
+    char data[MaxReliableSize], buffer[MaxMailSize];
+    int level, i, start, resent, ticks, errors;
+    int sent = 0, received = 0;
+
+    outPktHdr.to = farAddr;		
+    outMailHdr.to = 0;
+    outMailHdr.from = 1;
+    outMailHdr.length = MaxReliableSize;
+    for (level = 5; level <= 10; level++) {
+	postOffice->SetReliability(level / 10.0);
+	start = stats->totalTicks;
+	resent = stats->numRetransmits;
+	errors = 0;
+
+	for (i = 0; i < ReliablePackets; i++) {
+	    *(int *) data = sent++;
+	    postOffice->SendReliable(outPktHdr, outMailHdr, data);
+	}
+	for (i = 0; i < ReliablePackets; i++) {
+	    postOffice->Receive(0, &inPktHdr, &inMailHdr, buffer);
+	    if (*(int *) buffer != received++)
+		errors++;
+	}
+	postOffice->WaitForAcks(farAddr);
+
+	ticks = stats->totalTicks - start;
+	printf("reliability %.1f: %d ticks, %d retransmitted, %d out of "
+		"order, %d bytes per 1000 ticks\n", level / 10.0, ticks,
+		stats->numRetransmits - resent, errors,
+		(int) (2000.0 * ReliablePackets * MaxReliableSize / ticks));
+	fflush(stdout);
+    }
+
+    interrupt->Halt();
+}
+
+// Run a distributed algorithm on many machines at once, all simulated
+// by this Nachos and connected by a Fabric: elect a leader on a ring
+// (Chang and Roberts).  Each machine sends its id to the next one;
+// ids smaller than the machine's own are swallowed, larger ones passed
+// on, so only the largest comes all the way around.  Its owner then
+// announces itself around the ring.  Up to MaxPeers machines can take
+// part, since that is how many peers a post office keeps track of.
+//	./nachos -of 100 0.9
+
+#define FabricLatency	(2 * NetworkTime)
+
+enum ElectionKind { Candidate, Elected };
+
+struct Election {
+    ElectionKind kind;
+    int id;
+};
+
+static PostOffice **ring;		// each machine's post office
+static int ringSize;
+static int *leaders;			// who each machine thinks won
+static Semaphore *electionDone;
+
+static int
+RingId(int node)
+{
+    return (node * 37 + 11) % 1000;	// distinct, in no particular order
+}
+
+static void
+Elect(int node)
+{
+    PostOffice *post = ring[node];
+    PacketHeader outPktHdr, inPktHdr;
+    MailHeader outMailHdr, inMailHdr;
+    Election out, in;
+    int me = RingId(node);
+
+    outPktHdr.to = (node + 1) % ringSize;
+    outMailHdr.to = 0;
+    outMailHdr.from = 0;
+    outMailHdr.length = sizeof(Election);
+
+    out.kind = Candidate;
+    out.id = me;
+    post->SendReliable(outPktHdr, outMailHdr, (char *) &out);
+    for (;;) {
+	post->Receive(0, &inPktHdr, &inMailHdr, (char *) &in);
+	if (in.kind == Elected) {
+	    leaders[node] = in.id;
+	    if (in.id != me)		// pass the news on
+		post->SendReliable(outPktHdr, outMailHdr, (char *) &in);
+	    break;
+	}
+	if (in.id == me) {		// we won
+	    out.kind = Elected;
+	    post->SendReliable(outPktHdr, outMailHdr, (char *) &out);
+	} else if (in.id > me)
+	    post->SendReliable(outPktHdr, outMailHdr, (char *) &in);
+    }
+    post->WaitForAcks(outPktHdr.to);
+    electionDone->V();
+}
+
+void
+FabricTest(int machines, double reliability)
+{
+    Fabric *fabric = new Fabric(machines, FabricLatency, reliability);
+    int i, start = stats->totalTicks, sent = stats->numPacketsSent;
+    int resent = stats->numRetransmits, highest = 0, agreed = 0;
+    char *name;
+    Thread *t;
+
+    if ((machines < 2) || (machines > MaxPeers)) {
+	printf("Need 2 to %d machines for an election\n", MaxPeers);
+	return;
+    }
+    ringSize = machines;
+    ring = new PostOffice *[machines];
+    leaders = new int[machines];
+    electionDone = new Semaphore("election done", 0);
+    for (i = 0; i < machines; i++)
+	ring[i] = new PostOffice(i, fabric, 1);
+    for (i = 0; i < machines; i++) {
+	name = new char[20];
+	sprintf(name, "machine %d", i);
+	t = new Thread(name, GET_NICE_FROM_PARENT);
+	t->Fork(Elect, i);
+    }
+    for (i = 0; i < machines; i++)
+	electionDone->P();
+
+    for (i = 0; i < machines; i++)
+	highest = max(highest, RingId(i));
+    for (i = 0; i < machines; i++)
+	if (leaders[i] == highest)
+	    agreed++;
+    printf("%d machines, reliability %.2f: %d agree on leader %d, "
+		"%d ticks, %d packets, %d retransmitted\n", machines, 
+		reliability, agreed, highest, stats->totalTicks - start, 
+		stats->numPacketsSent - sent, stats->numRetransmits - resent);
+    fflush(stdout);
+
+    interrupt->Halt();
+}
@@ -18,24 +18,131 @@
 
 #include "copyright.h"
 #include "post.h"
+#include "system.h"
+
+// Bounds on the retransmission timeout, and where it starts before we
+// have measured any round trips
+
+#define InitialTimeout	(20 * NetworkTime)
+#define MinTimeout	(4 * NetworkTime)
+#define MaxTimeout	(640 * NetworkTime)
 
 //----------------------------------------------------------------------
 // Mail::Mail
-//      Initialize a single mail message, by concatenating the headers to
-//	the data.
+//      Initialize a single mail message, with a buffer big enough for
+//	any packet.  The Network reads packets into it.
+//----------------------------------------------------------------------
+
+Mail::Mail()
+{
+    packet = new char[MaxWireSize];
+    data = NULL;
+    next = NULL;
+}
+
+//----------------------------------------------------------------------
+// Mail::~Mail
+//      De-allocate a mail message.
+//----------------------------------------------------------------------
+
+Mail::~Mail()
+{
+    delete [] packet;
+}
+
+//----------------------------------------------------------------------
+// Mail::Parse
+//      Split the packet that has arrived in our buffer into its packet
+//	header, mail header, and data.  The headers are copied out, but
+//	the data is left where it is.
+//----------------------------------------------------------------------
+
+void
+Mail::Parse()
+{
+    pktHdr = *(PacketHeader *) packet;
+    mailHdr = *(MailHeader *) (packet + sizeof(PacketHeader));
+    data = packet + sizeof(PacketHeader) + sizeof(MailHeader);
+    ASSERT(mailHdr.length <= MaxMailSize);
+}
+
+//----------------------------------------------------------------------
+// NewMail, FreeMail
+//      Keep a pool of mail that has been received and can be used again,
+//	so that once there is enough of it, receiving a packet doesn't
+//	allocate anything.  The pool grows to as much mail as has ever
+//	been waiting to be received at once.
+//
+//	Mail is taken by the postal worker and given back by whichever
+//	thread receives it, so the pool is protected by turning off 
+//	interrupts.
+//----------------------------------------------------------------------
+
+static Mail *mailPool = NULL;		// mail ready to be reused
+
+static Mail *
+NewMail()
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    Mail *mail = mailPool;
+
+    if (mail != NULL)
+	mailPool = mail->next;
+    (void) interrupt->SetLevel(oldLevel);
+    if (mail == NULL)
+	mail = new Mail;
+    return mail;
+}
+
+static void
+FreeMail(Mail *mail)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    mail->next = mailPool;
+    mailPool = mail;
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// Connection::Connection
+//      Initialize the state of reliable delivery to and from one 
+//	other machine: nothing has been sent or received yet.
+//----------------------------------------------------------------------
+
+Connection::Connection()
+{
+    nextSeq = unacked = expected = 0;
+    deadline = 0;
+    timed = FALSE;
+    smoothed = deviation = 0;
+    timeout = InitialTimeout;
+}
+
+//----------------------------------------------------------------------
+// Connection::Sample
+//      Fold a measured round trip time into our estimate of the round
+//	trip time and its deviation, and set the retransmission timeout
+//	a few deviations above the estimate, as TCP does.
 //
-//	"pktH" -- source, destination machine ID's
-//	"mailH" -- source, destination mailbox ID's
-//	"data" -- payload data
+//	"rtt" -- ticks between sending a packet and its acknowledgement
 //----------------------------------------------------------------------
 
-Mail::Mail(PacketHeader pktH, MailHeader mailH, char *msgData)
+void
+Connection::Sample(int rtt)
 {
-    ASSERT(mailH.length <= MaxMailSize);
+    int error;
 
-    pktHdr = pktH;
-    mailHdr = mailH;
-    bcopy(msgData, data, mailHdr.length);
+    if (!timed) {
+	timed = TRUE;
+	smoothed = rtt;
+	deviation = rtt / 2;
+    } else {
+	error = (rtt > smoothed) ? rtt - smoothed : smoothed - rtt;
+	deviation = (3 * deviation + error) / 4;
+	smoothed = (7 * smoothed + rtt) / 8;
+    }
+    timeout = max(MinTimeout, min(smoothed + 4 * deviation, MaxTimeout));
 }
 
 //----------------------------------------------------------------------
@@ -43,13 +150,16 @@ Mail::Mail(PacketHeader pktH, MailHeader mailH, char *msgData)
 //      Initialize a single mail box within the post office, so that it
 //	can receive incoming messages.
 //
-//	Just initialize a list of messages, representing the mailbox.
+//	Just initialize a list of messages, representing the mailbox,
+//	and the semaphore and condition that synchronize access to it.
 //----------------------------------------------------------------------
 
 
 MailBox::MailBox()
 { 
-    messages = new SynchList(); 
+    first = last = NULL;
+    mutex = new Semaphore("mailbox", 1);
+    arrived = new Condition("mail arrived");
 }
 
 //----------------------------------------------------------------------
@@ -62,7 +172,14 @@ MailBox::MailBox()
 
 MailBox::~MailBox()
 { 
-    delete messages; 
+    Mail *mail;
+
+    while ((mail = first) != NULL) {
+	first = mail->next;
+	delete mail;
+    }
+    delete mutex;
+    delete arrived;
 }
 
 //----------------------------------------------------------------------
@@ -86,22 +203,58 @@ PrintHeader(PacketHeader pktHdr, MailHeader mailHdr)
 // 	Add a message to the mailbox.  If anyone is waiting for message
 //	arrival, wake them up!
 //
-//	We need to reconstruct the Mail message (by concatenating the headers
-//	to the data), to simplify queueing the message on the SynchList.
+//	Everyone waiting is woken, since a thread reassembling a message
+//	is only interested in mail from one sender.
 //
-//	"pktHdr" -- source, destination machine ID's
-//	"mailHdr" -- source, destination mailbox ID's
-//	"data" -- payload message data
+//	"mail" -- the message, parsed; the mailbox now owns it
 //----------------------------------------------------------------------
 
 void 
-MailBox::Put(PacketHeader pktHdr, MailHeader mailHdr, char *data)
+MailBox::Put(Mail *mail)
 { 
-    Mail *mail = new Mail(pktHdr, mailHdr, data); 
+    mail->next = NULL;
+    mutex->P();
+    if (last == NULL)			// put on the end of the list of 
+	first = mail;			// arrived messages, and wake up 
+    else				// any waiters
+	last->next = mail;
+    last = mail;
+    arrived->Broadcast();
+    mutex->V();
+}
 
-    messages->Append((void *)mail);	// put on the end of the list of 
-					// arrived messages, and wake up 
-					// any waiters
+//----------------------------------------------------------------------
+// MailBox::Take
+// 	Remove the first message from "from", mailbox "fromBox" (or the
+//	first message from anyone, if "any" is set), waiting until there
+//	is one.  Messages from other senders stay in the box, in order.
+//
+//	The caller must hold "mutex".
+//----------------------------------------------------------------------
+
+Mail *
+MailBox::Take(NetworkAddress from, MailBoxAddress fromBox, bool any)
+{
+    Mail *mail, *prev;
+
+    for (;;) {
+	prev = NULL;
+	for (mail = first; mail != NULL; prev = mail, mail = mail->next)
+	    if (any || (mail->pktHdr.from == from 
+				&& mail->mailHdr.from == fromBox))
+		break;
+	if (mail != NULL)
+	    break;
+	arrived->Wait(mutex);		// nothing for us yet
+    }
+
+    if (prev == NULL)			// unlink it
+	first = mail->next;
+    else
+	prev->next = mail->next;
+    if (last == mail)
+	last = prev;
+    return mail;
 }
 
 //----------------------------------------------------------------------
@@ -120,8 +273,10 @@ void
 MailBox::Get(PacketHeader *pktHdr, MailHeader *mailHdr, char *data) 
 { 
     DEBUG('n', "Waiting for mail in mailbox\n");
-    Mail *mail = (Mail *) messages->Remove();	// remove message from list;
-						// will wait if list is empty
+    mutex->P();
+    Mail *mail = Take(0, 0, TRUE);	// remove message from list;
+					// will wait if list is empty
+    mutex->V();
 
     *pktHdr = mail->pktHdr;
     *mailHdr = mail->mailHdr;
@@ -132,8 +287,106 @@ MailBox::Get(PacketHeader *pktHdr, MailHeader *mailHdr, char *data)
     bcopy(mail->data, data, mail->mailHdr.length);
 					// copy the message data into
 					// the caller's buffer
-    delete mail;			// we've copied out the stuff we
-					// need, we can now discard the message
+    FreeMail(mail);			// we've copied out the stuff we
+					// need, we can now reuse the message
+}
+
+//----------------------------------------------------------------------
+// MailBox::GetMessage
+// 	Get the next message sent with PostOffice::SendMessage, copying
+//	each fragment's data straight to its place in the caller's buffer
+//	as it arrives.  The headers returned are those of the first
+//	fragment, with the length set to the length of the whole message.
+//
+//	The network is ordered, so once the first fragment is in, the rest
+//	come from the same sender in order.  If one is dropped, the next
+//	mail from that sender belongs to a later message; we give up on
+//	the one we had and start on that one instead.  Fragments from the
+//	middle of a message whose start we missed are thrown away.
+//
+//	Fragments come off the wire, so they are checked: mail that is
+//	too short to be a fragment, or that would fall outside its
+//	message, is thrown away too.  A message longer than "maxLength"
+//	is received but not copied, and -1 is returned for it.
+//
+//	"pktHdr" -- address to put: source, destination machine ID's
+//	"mailHdr" -- address to put: source, destination mailbox ID's
+//	"data" -- address to put: the message
+//	"maxLength" -- the size of "data"
+//----------------------------------------------------------------------
+
+int
+MailBox::GetMessage(PacketHeader *pktHdr, MailHeader *mailHdr, char *data,
+		int maxLength)
+{
+    bool started = FALSE;
+    NetworkAddress from = 0;
+    MailBoxAddress fromBox = 0;
+    unsigned id = 0;
+    int total = 0, received = 0;
+    bool fits = TRUE;
+    Mail *mail;
+    FragmentHeader *frag;
+    int length;
+
+    DEBUG('n', "Waiting for a message in mailbox\n");
+    mutex->P();
+    for (;;) {
+	mail = Take(from, fromBox, !started);
+	if (mail->mailHdr.length < sizeof(FragmentHeader)) {
+	    DEBUG('n', "Dropping mail too short to be a fragment\n");
+	    FreeMail(mail);
+	    continue;
+	}
+	frag = (FragmentHeader *) mail->data;
+	length = mail->mailHdr.length - sizeof(FragmentHeader);
+
+	if (started && frag->id != id) {
+	    DEBUG('n', "Lost part of message %d, %d of %d bytes arrived\n",
+			id, received, total);
+	    started = FALSE;
+	}
+	if (!started) {
+	    if ((frag->offset != 0) || (frag->total < length)) {
+		FreeMail(mail);		// we missed the start, or it's bad
+		continue;
+	    }
+	    started = TRUE;
+	    from = mail->pktHdr.from;
+	    fromBox = mail->mailHdr.from;
+	    id = frag->id;
+	    total = frag->total;
+	    received = 0;
+	    fits = (total <= maxLength);
+	    *pktHdr = mail->pktHdr;
+	    *mailHdr = mail->mailHdr;
+	}
+	if ((frag->offset < 0) || (frag->offset > total - length)) {
+	    DEBUG('n', "Dropping fragment outside message %d\n", id);
+	    FreeMail(mail);
+	    continue;
+	}
+	if (fits)
+	    bcopy(mail->data + sizeof(FragmentHeader), data + frag->offset, 
+		length);
+	received += length;
+	FreeMail(mail);
+	if (received >= total)
+	    break;
+    }
+    mutex->V();
+
+    mailHdr->length = total;
+    if (DebugIsEnabled('n')) {
+	printf("Got message from mailbox: ");
+	PrintHeader(*pktHdr, *mailHdr);
+    }
+    if (!fits) {
+	DEBUG('n', "Message of %d bytes dropped, buffer holds %d\n",
+		total, maxLength);
+	return -1;
+    }
+    return total;
 }
 
 //----------------------------------------------------------------------
@@ -151,6 +404,8 @@ static void ReadAvail(int arg)
 { PostOffice* po = (PostOffice *) arg; po->IncomingPacket(); }
 static void WriteDone(int arg)
 { PostOffice* po = (PostOffice *) arg; po->PacketSent(); }
+static void RetransmitHandler(int arg)
+{ PostOffice* po = (PostOffice *) arg; po->RetransmitAlarm(); }
 
 //----------------------------------------------------------------------
 // PostOffice::PostOffice
@@ -173,15 +428,7 @@ static void WriteDone(int arg)
 
 PostOffice::PostOffice(NetworkAddress addr, double reliability, int nBoxes)
 {
-// First, initialize the synchronization with the interrupt handlers
-    messageAvailable = new Semaphore("message available", 0);
-    messageSent = new Semaphore("message sent", 0);
-    sendLock = new Lock("message send lock");
-
-// Second, initialize the mailboxes
-    netAddr = addr; 
-    numBoxes = nBoxes;
-    boxes = new MailBox[nBoxes];
+    Initialize(addr, nBoxes);
 
 // Third, initialize the network; tell it which interrupt handlers to call
     network = new Network(addr, reliability, ReadAvail, WriteDone, (int) this);
@@ -189,11 +436,60 @@ PostOffice::PostOffice(NetworkAddress addr, double reliability, int nBoxes)
 
 // Finally, create a thread whose sole job is to wait for incoming messages,
 //   and put them in the right mailbox. 
-    Thread *t = new Thread("postal worker");
+    Thread *t = new Thread("postal worker", MIN_NICE_PRIORITY);
+
+    t->Fork(PostalHelper, (int) this);
+}
+
+//----------------------------------------------------------------------
+// PostOffice::PostOffice
+// 	Initialize the post office of machine "addr" on "fabric", one of
+//	the machines simulated by this Nachos.  Just as above, except
+//	for the network device.
+//----------------------------------------------------------------------
+
+PostOffice::PostOffice(NetworkAddress addr, Fabric *fabric, int nBoxes)
+{
+    Initialize(addr, nBoxes);
+    network = new Network(addr, fabric, ReadAvail, WriteDone, (int) this);
+
+    Thread *t = new Thread("postal worker", MIN_NICE_PRIORITY);
 
     t->Fork(PostalHelper, (int) this);
 }
 
+//----------------------------------------------------------------------
+// PostOffice::Initialize
+// 	Set up the synchronization and the mailboxes of a new post office.
+//----------------------------------------------------------------------
+
+void
+PostOffice::Initialize(NetworkAddress addr, int nBoxes)
+{
+    int i;
+
+// First, initialize the synchronization with the interrupt handlers
+    messageAvailable = new Semaphore("message available", 0);
+    freeBuffers = new Semaphore("free transmit buffers", TransmitBuffers);
+    for (i = 0; i < TransmitBuffers; i++)
+	outReady[i] = FALSE;
+    outHead = outTail = 0;
+    sending = FALSE;
+    nextMessageId = 0;
+    peers = new Connection *[MaxPeers];
+    for (i = 0; i < MaxPeers; i++)
+	peers[i] = NULL;
+    transportLock = new Semaphore("transport lock", 1);
+    acked = new Condition("packets acknowledged");
+    timeoutDue = FALSE;
+    timerAt = 0;
+
+// Second, initialize the mailboxes
+    netAddr = addr; 
+    numBoxes = nBoxes;
+    boxes = new MailBox[nBoxes];
+}
+
 //----------------------------------------------------------------------
 // PostOffice::~PostOffice
 // 	De-allocate the post office data structures.
@@ -204,42 +500,80 @@ PostOffice::~PostOffice()
     delete network;
     delete [] boxes;
     delete messageAvailable;
-    delete messageSent;
-    delete sendLock;
+    delete freeBuffers;
+    for (int i = 0; i < MaxPeers; i++)
+	if (peers[i] != NULL)
+	    delete peers[i];
+    delete [] peers;
+    delete transportLock;
+    delete acked;
 }
 
 //----------------------------------------------------------------------
 // PostOffice::PostalDelivery
 // 	Wait for incoming messages, and put them in the right mailbox.
 //
-//      Incoming messages have had the PacketHeader stripped off,
-//	but the MailHeader is still tacked on the front of the data.
+//      Incoming messages come from the Network whole, PacketHeader,
+//	MailHeader and data, in a buffer that becomes part of a Mail; 
+//	the Network gets the Mail's old buffer in return.
+//
+//	The postal worker also takes care of reliable delivery: it 
+//	acknowledges reliable data, throwing away duplicates, uses up
+//	acknowledgements, and sends packets again when RetransmitAlarm
+//	says their time is up.
 //----------------------------------------------------------------------
 
 void
 PostOffice::PostalDelivery()
 {
-    PacketHeader pktHdr;
-    MailHeader mailHdr;
-    char *buffer = new char[MaxPacketSize];
+    Mail *mail = NULL;
+    char *full;
+    TransportHeader *transHdr;
+    IntStatus oldLevel;
+    bool retransmit;
 
     for (;;) {
-        // first, wait for a message
+        // first, wait for a message, or a timeout
         messageAvailable->P();	
-        pktHdr = network->Receive(buffer);
+	oldLevel = interrupt->SetLevel(IntOff);
+	retransmit = timeoutDue;
+	timeoutDue = FALSE;
+	(void) interrupt->SetLevel(oldLevel);
+	if (retransmit)
+	    Retransmit();
+
+	// trade the network an empty buffer for the one holding the packet
+	if (mail == NULL)
+	    mail = NewMail();
+	full = network->Receive(mail->packet);
+	if (full == NULL)		// woken up just to retransmit
+	    continue;
+	mail->packet = full;
+	mail->Parse();
 
-        mailHdr = *(MailHeader *)buffer;
         if (DebugIsEnabled('n')) {
 	    printf("Putting mail into mailbox: ");
-	    PrintHeader(pktHdr, mailHdr);
+	    PrintHeader(mail->pktHdr, mail->mailHdr);
         }
 
 	// check that arriving message is legal!
-	ASSERT(0 <= mailHdr.to && mailHdr.to < numBoxes);
-	ASSERT(mailHdr.length <= MaxMailSize);
+	ASSERT(0 <= mail->mailHdr.to && mail->mailHdr.to < numBoxes);
 
-	// put into mailbox
-        boxes[mailHdr.to].Put(pktHdr, mailHdr, buffer + sizeof(MailHeader));
+	transHdr = (TransportHeader *) mail->data;
+	if (mail->mailHdr.kind == ReliableAck) {
+	    Acknowledged(mail->pktHdr.from, transHdr->seq);
+	    continue;			// keep the mail for the next packet
+	}
+	if (mail->mailHdr.kind == ReliableData) {
+	    if (!Accept(mail->pktHdr.from, transHdr->seq))
+		continue;		// we already have it
+	    mail->data += sizeof(TransportHeader);
+	    mail->mailHdr.length -= sizeof(TransportHeader);
+	}
+
+	// put into mailbox; the mailbox owns it now
+        boxes[mail->mailHdr.to].Put(mail);
+	mail = NULL;
     }
 }
 
@@ -251,6 +585,8 @@ PostOffice::PostalDelivery()
 //	Note that the MailHeader + data looks just like normal payload
 //	data to the Network.
 //
+//	We return as soon as the message is queued to be sent.
+//
 //	"pktHdr" -- source, destination machine ID's
 //	"mailHdr" -- source, destination mailbox ID's
 //	"data" -- payload message data
@@ -259,8 +595,9 @@ PostOffice::PostalDelivery()
 void
 PostOffice::Send(PacketHeader pktHdr, MailHeader mailHdr, char* data)
 {
-    char* buffer = new char[MaxPacketSize];	// space to hold concatenated
-						// mailHdr + data
+    int slot = GetBuffer();
+    char* buffer = outBuffers[slot];	// space to hold concatenated
+					// mailHdr + data
 
     if (DebugIsEnabled('n')) {
 	printf("Post send: ");
@@ -272,20 +609,368 @@ PostOffice::Send(PacketHeader pktHdr, MailHeader mailHdr, char* data)
     // fill in pktHdr, for the Network layer
     pktHdr.from = netAddr;
     pktHdr.length = mailHdr.length + sizeof(MailHeader);
+    mailHdr.kind = PlainMail;
 
     // concatenate MailHeader and data
     bcopy(&mailHdr, buffer, sizeof(MailHeader));
     bcopy(data, buffer + sizeof(MailHeader), mailHdr.length);
 
-    sendLock->Acquire();   		// only one message can be sent
-					// to the network at any one time
-    network->Send(pktHdr, buffer);
-    messageSent->P();			// wait for interrupt to tell us
-					// ok to send the next message
-    sendLock->Release();
+    Transmit(pktHdr, slot);
+}
+
+//----------------------------------------------------------------------
+// PostOffice::SendMessage
+// 	Send a message that may be too long to fit in one piece of mail.
+//	The message is cut into fragments of at most MaxFragmentSize
+//	bytes, each sent as a piece of mail with a FragmentHeader in
+//	front of its data.  Each fragment is put together right in its
+//	transmit buffer.
+//
+//	"pktHdr" -- source, destination machine ID's
+//	"mailHdr" -- source, destination mailbox ID's; length is the length
+//		of the whole message
+//	"data" -- the message
+//----------------------------------------------------------------------
+
+void
+PostOffice::SendMessage(PacketHeader pktHdr, MailHeader mailHdr, char *data)
+{
+    FragmentHeader frag;
+    char *buffer;
+    int total = mailHdr.length;
+    int length, slot;
+
+    if (DebugIsEnabled('n')) {
+	printf("Post send message: ");
+	PrintHeader(pktHdr, mailHdr);
+    }
+    ASSERT(0 <= mailHdr.to && mailHdr.to < numBoxes);
+
+    pktHdr.from = netAddr;
+    mailHdr.kind = PlainMail;
+    frag.id = nextMessageId++;
+    frag.total = total;
+    frag.offset = 0;
+    do {
+	length = min(total - frag.offset, MaxFragmentSize);
+	mailHdr.length = sizeof(FragmentHeader) + length;
+	pktHdr.length = mailHdr.length + sizeof(MailHeader);
 
-    delete [] buffer;			// we've sent the message, so
-					// we can delete our buffer
+	slot = GetBuffer();
+	buffer = outBuffers[slot];
+	bcopy(&mailHdr, buffer, sizeof(MailHeader));
+	bcopy(&frag, buffer + sizeof(MailHeader), sizeof(FragmentHeader));
+	bcopy(data + frag.offset, buffer + sizeof(MailHeader) 
+				+ sizeof(FragmentHeader), length);
+
+	Transmit(pktHdr, slot);
+	frag.offset += length;
+    } while (frag.offset < total);
+}
+
+//----------------------------------------------------------------------
+// PostOffice::SendReliable
+// 	Send a piece of mail that is sure to get to the mailbox on the
+//	other machine, once, and after anything sent reliably before it.
+//
+//	The mail gets the next sequence number to the other machine, and
+//	is kept in the window until it is acknowledged, so that it can be
+//	sent again.  If the window is full, we wait for it to slide.
+//
+//	"pktHdr" -- source, destination machine ID's
+//	"mailHdr" -- source, destination mailbox ID's
+//	"data" -- payload message data, at most MaxReliableSize bytes
+//----------------------------------------------------------------------
+
+void
+PostOffice::SendReliable(PacketHeader pktHdr, MailHeader mailHdr, char *data)
+{
+    Connection *conn = Peer(pktHdr.to);
+    TransportHeader transHdr;
+    char *buffer;
+    int slot, out;
+
+    if (DebugIsEnabled('n')) {
+	printf("Post send reliable: ");
+	PrintHeader(pktHdr, mailHdr);
+    }
+    ASSERT(mailHdr.length <= MaxReliableSize);
+    ASSERT(0 <= mailHdr.to && mailHdr.to < numBoxes);
+
+    pktHdr.from = netAddr;
+    mailHdr.kind = ReliableData;
+    mailHdr.length += sizeof(TransportHeader);
+    pktHdr.length = mailHdr.length + sizeof(MailHeader);
+
+    transportLock->P();
+    while (conn->nextSeq - conn->unacked >= WindowSize)
+	acked->Wait(transportLock);	// window is full
+    transHdr.seq = conn->nextSeq++;
+    slot = transHdr.seq % WindowSize;
+    buffer = conn->window[slot];
+    bcopy(&mailHdr, buffer, sizeof(MailHeader));
+    bcopy(&transHdr, buffer + sizeof(MailHeader), sizeof(TransportHeader));
+    bcopy(data, buffer + sizeof(MailHeader) + sizeof(TransportHeader), 
+		mailHdr.length - sizeof(TransportHeader));
+    conn->sent[slot] = pktHdr;
+    conn->sentAt[slot] = stats->totalTicks;
+    conn->resent[slot] = FALSE;
+    if (transHdr.seq == conn->unacked) {	// the window was empty
+	conn->deadline = stats->totalTicks + conn->timeout;
+	StartTimer(conn->deadline);
+    }
+
+    // Copy the packet from the window to a transmit buffer.  Like
+    // Retransmit, we take the buffer while holding transportLock, and
+    // fill it right away: a buffer claimed but not yet filled holds up
+    // every packet queued behind it.
+    out = GetBuffer();
+    bcopy(buffer, outBuffers[out], pktHdr.length);
+    Transmit(pktHdr, out);
+    transportLock->V();
+}
+
+//----------------------------------------------------------------------
+// PostOffice::WaitForAcks
+// 	Wait until everything we have sent reliably to machine "to" has
+//	been acknowledged.
+//----------------------------------------------------------------------
+
+void
+PostOffice::WaitForAcks(NetworkAddress to)
+{
+    Connection *conn = Peer(to);
+
+    transportLock->P();
+    while (conn->unacked != conn->nextSeq)
+	acked->Wait(transportLock);
+    transportLock->V();
+}
+
+//----------------------------------------------------------------------
+// PostOffice::Peer
+// 	Return the reliable delivery state for machine "addr", creating
+//	it the first time we talk to that machine.
+//----------------------------------------------------------------------
+
+Connection *
+PostOffice::Peer(NetworkAddress addr)
+{
+    ASSERT(0 <= addr && addr < MaxPeers);
+    if (peers[addr] == NULL)
+	peers[addr] = new Connection;
+    return peers[addr];
+}
+
+//----------------------------------------------------------------------
+// PostOffice::Accept
+// 	Called by the postal worker for each piece of reliable data.
+//	Return TRUE if it is the next one we expect from that machine, 
+//	and FALSE if it is a copy of one we already have.  The network
+//	is ordered, so anything else means one before it was lost; we
+//	throw it away too, and wait for the sender to go back for it.
+//
+//	Either way we acknowledge everything received so far, in case
+//	our earlier acknowledgement was lost.
+//
+//	"from" -- the machine that sent it
+//	"seq" -- its sequence number
+//----------------------------------------------------------------------
+
+bool
+PostOffice::Accept(NetworkAddress from, unsigned seq)
+{
+    Connection *conn = Peer(from);
+    int out = GetBuffer();
+    MailHeader *mailHdr = (MailHeader *) outBuffers[out];
+    TransportHeader *transHdr = (TransportHeader *) 
+				(outBuffers[out] + sizeof(MailHeader));
+    PacketHeader pktHdr;
+    bool next = (seq == conn->expected);
+
+    if (next)
+	conn->expected++;
+    else
+	DEBUG('n', "Reliable data %d from %d out of order, expected %d\n",
+			seq, from, conn->expected);
+
+    pktHdr.to = from;
+    pktHdr.from = netAddr;
+    pktHdr.length = sizeof(MailHeader) + sizeof(TransportHeader);
+    mailHdr->to = mailHdr->from = 0;
+    mailHdr->length = sizeof(TransportHeader);
+    mailHdr->kind = ReliableAck;
+    transHdr->seq = conn->expected;
+    Transmit(pktHdr, out);
+    return next;
+}
+
+//----------------------------------------------------------------------
+// PostOffice::Acknowledged
+// 	Called by the postal worker when machine "from" acknowledges 
+//	everything we sent it before sequence number "seq".  Slide the 
+//	window forward, and wake up anyone waiting for room in it.
+//
+//	The newest packet acknowledged gives us a round trip time, unless
+//	it was sent more than once: then we can't tell which copy the 
+//	acknowledgement is for.
+//----------------------------------------------------------------------
+
+void
+PostOffice::Acknowledged(NetworkAddress from, unsigned seq)
+{
+    Connection *conn = Peer(from);
+    int newest = (seq - 1) % WindowSize;
+
+    transportLock->P();
+    if ((seq == conn->unacked) 
+		|| (seq - conn->unacked > conn->nextSeq - conn->unacked)) {
+	transportLock->V();		// nothing new
+	return;
+    }
+    if (!conn->resent[newest])
+	conn->Sample(stats->totalTicks - conn->sentAt[newest]);
+    conn->unacked = seq;
+    if (conn->unacked != conn->nextSeq) {	// restart the clock
+	conn->deadline = stats->totalTicks + conn->timeout;
+	StartTimer(conn->deadline);
+    }
+    acked->Broadcast();
+    transportLock->V();
+}
+
+//----------------------------------------------------------------------
+// PostOffice::Retransmit
+// 	Called by the postal worker after RetransmitAlarm.  To each 
+//	machine whose oldest unacknowledged packet has timed out, send 
+//	the whole window again, and back off: double the timeout, in
+//	case the network is just slower than we thought.
+//----------------------------------------------------------------------
+
+void
+PostOffice::Retransmit()
+{
+    Connection *conn;
+    unsigned seq;
+    int i, slot, out;
+
+    transportLock->P();
+    for (i = 0; i < MaxPeers; i++) {
+	conn = peers[i];
+	if ((conn == NULL) || (conn->unacked == conn->nextSeq))
+	    continue;			// nothing in flight
+	if (stats->totalTicks < conn->deadline) {
+	    StartTimer(conn->deadline);
+	    continue;
+	}
+	DEBUG('n', "Timeout to %d; sending %d through %d again\n", i,
+			conn->unacked, conn->nextSeq - 1);
+	conn->timeout = min(2 * conn->timeout, MaxTimeout);
+	for (seq = conn->unacked; seq != conn->nextSeq; seq++) {
+	    slot = seq % WindowSize;
+	    conn->resent[slot] = TRUE;
+	    stats->numRetransmits++;
+	    out = GetBuffer();
+	    bcopy(conn->window[slot], outBuffers[out], 
+			conn->sent[slot].length);
+	    Transmit(conn->sent[slot], out);
+	}
+	conn->deadline = stats->totalTicks + conn->timeout;
+	StartTimer(conn->deadline);
+    }
+    transportLock->V();
+}
+
+//----------------------------------------------------------------------
+// PostOffice::StartTimer
+// 	Make sure RetransmitAlarm will be called by time "when".  We can't
+//	cancel an alarm, so one may go off when there is nothing to do;
+//	Retransmit just sets the next one.
+//----------------------------------------------------------------------
+
+void
+PostOffice::StartTimer(int when)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    if ((timerAt == 0) || (when < timerAt)) {
+	timerAt = when;
+	interrupt->Schedule(RetransmitHandler, (int) this, 
+		max(when - stats->totalTicks, 1), NetworkTimeoutInt);
+    }
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// PostOffice::SetReliability
+// 	Change the chance that the packets we send get through.
+//----------------------------------------------------------------------
+
+void
+PostOffice::SetReliability(double reliability)
+{
+    network->SetReliability(reliability);
+}
+
+//----------------------------------------------------------------------
+// PostOffice::GetBuffer
+// 	Wait for a free transmit buffer, and return its number.  Buffers
+//	are handed out, and go on the network, in order around the queue.
+//----------------------------------------------------------------------
+
+int
+PostOffice::GetBuffer()
+{
+    IntStatus oldLevel;
+    int slot;
+
+    freeBuffers->P();
+    oldLevel = interrupt->SetLevel(IntOff);
+    slot = outTail;
+    outTail = (outTail + 1) % TransmitBuffers;
+    (void) interrupt->SetLevel(oldLevel);
+    return slot;
+}
+
+//----------------------------------------------------------------------
+// PostOffice::Transmit
+// 	Queue a packet, which the caller has put together in a buffer
+//	from GetBuffer, to be put on the network.  We don't wait for it
+//	to go out: PacketSent starts on the next packet as soon as the
+//	network is done with this one.
+//
+//	"pktHdr" -- source, destination machine ID's, and length
+//	"slot" -- the transmit buffer holding MailHeader + data
+//----------------------------------------------------------------------
+
+void
+PostOffice::Transmit(PacketHeader pktHdr, int slot)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    outHeaders[slot] = pktHdr;
+    outReady[slot] = TRUE;
+    StartSending();
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// PostOffice::StartSending
+// 	If the network is free, and the packet at the head of the transmit
+//	queue is ready, put it on the network.  A packet queued behind it 
+//	waits, even if it is ready first, so packets go out in the order
+//	their buffers were handed out.
+//
+//	Called with interrupts off.
+//----------------------------------------------------------------------
+
+void
+PostOffice::StartSending()
+{
+    if (!sending && outReady[outHead]) {
+	sending = TRUE;
+	network->Send(outHeaders[outHead], outBuffers[outHead]);
+    }
 }
 
 //----------------------------------------------------------------------
@@ -313,6 +998,28 @@ PostOffice::Receive(int box, PacketHeader *pktHdr,
     ASSERT(mailHdr->length <= MaxMailSize);
 }
 
+//----------------------------------------------------------------------
+// PostOffice::ReceiveMessage
+// 	Retrieve the next message sent to "box" with SendMessage, waiting
+//	for all of its fragments to arrive.  Returns its length, or -1 if
+//	it did not fit in "data".
+//
+//	"box" -- mailbox ID in which to look for the message
+//	"pktHdr" -- address to put: source, destination machine ID's
+//	"mailHdr" -- address to put: source, destination mailbox ID's
+//	"data" -- address to put: the message
+//	"maxLength" -- the size of "data"
+//----------------------------------------------------------------------
+
+int
+PostOffice::ReceiveMessage(int box, PacketHeader *pktHdr, 
+				MailHeader *mailHdr, char *data, int maxLength)
+{
+    ASSERT((box >= 0) && (box < numBoxes));
+
+    return boxes[box].GetMessage(pktHdr, mailHdr, data, maxLength);
+}
+
 //----------------------------------------------------------------------
 // PostOffice::IncomingPacket
 // 	Interrupt handler, called when a packet arrives from the network.
@@ -334,11 +1041,33 @@ PostOffice::IncomingPacket()
 //	The name of this routine is a misnomer; if "reliability < 1",
 //	the packet could have been dropped by the network, so it won't get
 //	through.
+//
+//	Free the packet's transmit buffer, and send the next one.
 //----------------------------------------------------------------------
 
 void 
 PostOffice::PacketSent()
 { 
-    messageSent->V();
+    outReady[outHead] = FALSE;
+    outHead = (outHead + 1) % TransmitBuffers;
+    sending = FALSE;
+    freeBuffers->V();
+    StartSending();
+}
+
+//----------------------------------------------------------------------
+// PostOffice::RetransmitAlarm
+// 	Interrupt handler, called when a retransmission timeout may have
+//	expired.  Sending packets can't be done here, so wake up the
+//	postal worker to do it.
+//----------------------------------------------------------------------
+
+void 
+PostOffice::RetransmitAlarm()
+{ 
+    if (stats->totalTicks >= timerAt)
+	timerAt = 0;
+    timeoutDue = TRUE;
+    messageAvailable->V();
 }
 
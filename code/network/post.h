@@ -19,6 +19,17 @@
 //	to which you can send an acknowledgement, if your protocol requires 
 //	this.
 //
+//	Mail is limited to what fits in one packet.  For anything larger,
+//	SendMessage splits the data into fragments, each carrying a
+//	FragmentHeader, and ReceiveMessage puts them back together
+//	directly in the caller's buffer.  A mailbox should be used either
+//	for mail or for messages, not both.
+//
+//	Mail sent with SendReliable is sure to arrive, once and in order.
+//	It carries a sequence number, and the receiving PostOffice answers
+//	with an acknowledgement; whatever isn't acknowledged in time is
+//	sent again.  It is received like any other mail.
+//
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
 // of liability and disclaimer of warranty provisions.
@@ -35,6 +46,11 @@
 // A mailbox is just a place for temporary storage for messages.
 typedef int MailBoxAddress;
 
+// What a piece of mail is to the PostOffice.  Reliable data goes into
+// a mailbox like plain mail, once it has been acknowledged; the 
+// acknowledgements themselves are used up by the PostOffice.
+enum MailKind { PlainMail, ReliableData, ReliableAck };
+
 // The following class defines part of the message header.  
 // This is prepended to the message by the PostOffice, before the message 
 // is sent to the Network.
@@ -45,6 +61,7 @@ class MailHeader {
     MailBoxAddress from;	// Mail box to reply to
     unsigned length;		// Bytes of message data (excluding the 
 				// mail header)
+    MailKind kind;		// Filled in by the PostOffice
 };
 
 // Maximum "payload" -- real data -- that can included in a single message
@@ -52,22 +69,95 @@ class MailHeader {
 
 #define MaxMailSize 	(MaxPacketSize - sizeof(MailHeader))
 
+// The following class defines the header on each fragment of a message
+// sent with SendMessage.  It is the first thing in the mail data; the
+// rest of the mail data is the piece of the message at "offset".
+// Fragments are matched up by the sender's address and mailbox, and
+// by "id", which the sending PostOffice makes unique for each message.
+
+class FragmentHeader {
+  public:
+    unsigned id;		// Which message this is a piece of
+    int offset;			// Where in the message this piece goes
+    int total;			// Bytes in the whole message
+};
+
+#define MaxFragmentSize	((int) (MaxMailSize - sizeof(FragmentHeader)))
+
+// The following class defines the header in front of the data of mail
+// sent with SendReliable.  In an acknowledgement, which has no data,
+// "seq" is the next sequence number the receiver expects: everything
+// before it has arrived.
+
+class TransportHeader {
+  public:
+    unsigned seq;		// Sequence number
+};
+
+#define MaxReliableSize	((int) (MaxMailSize - sizeof(TransportHeader)))
+
+// The following class defines the state of reliable delivery between
+// this machine and one other.  Up to WindowSize packets can be in
+// flight before they are acknowledged; if the oldest one isn't 
+// acknowledged before its timeout, they are all sent again.  The
+// timeout adapts to the round trip times we measure.
+
+#define WindowSize	8
+#define MaxPeers	128	// Machines we can talk to reliably
+
+// Outgoing packets wait in a queue of TransmitBuffers preallocated 
+// buffers, so that senders needn't wait for the network.
 
-// The following class defines the format of an incoming/outgoing 
-// "Mail" message.  The message format is layered: 
+#define TransmitBuffers	16
+
+class Connection {
+  public:
+    Connection();		// Nothing sent or received yet
+
+    void Sample(int rtt);	// Adjust the timeout to a measured
+				// round trip time
+
+    unsigned nextSeq;		// Sequence number of the next packet to send
+    unsigned unacked;		// Oldest packet not yet acknowledged
+    unsigned expected;		// Next sequence number we will accept
+    char window[WindowSize][MaxPacketSize];
+				// Packets in flight, by sequence number
+    PacketHeader sent[WindowSize]; // Their packet headers
+    int sentAt[WindowSize];	// When each was first sent
+    bool resent[WindowSize];	// Has it been sent again?  If so, its
+				// round trip time is ambiguous
+    int deadline;		// When to send the window again
+    bool timed;			// Have we measured a round trip yet?
+    int smoothed;		// Smoothed round trip time
+    int deviation;		// Smoothed deviation of the round trip time
+    int timeout;		// Current retransmission timeout
+};
+
+// The following class defines the format of an incoming "Mail" 
+// message.  The message format is layered: 
 //	network header (PacketHeader) 
 //	post office header (MailHeader) 
 //	data
+//
+// The Network hands us each packet in a buffer of its own, which
+// becomes the "packet" of a Mail; the payload stays where it is, and 
+// is copied only once, when a thread receives it.  Mail is kept for 
+// reuse once it has been received, rather than deleted.
 
 class Mail {
   public:
-     Mail(PacketHeader pktH, MailHeader mailH, char *msgData);
-				// Initialize a mail message by
-				// concatenating the headers to the data
+     Mail();			// Allocate a packet buffer
+     ~Mail();			// De-allocate it
+
+     void Parse();		// Fill in the headers and "data" from 
+				// the packet
 
      PacketHeader pktHdr;	// Header appended by Network
      MailHeader mailHdr;	// Header appended by PostOffice
-     char data[MaxMailSize];	// Payload -- message data
+     char *data;		// Payload -- message data, inside "packet"
+     char *packet;		// The packet, as it came off the wire
+     Mail *next;		// Next mail in the mailbox, or in the
+				// pool of unused mail
 };
 
 // The following class defines a single mailbox, or temporary storage
@@ -80,14 +170,27 @@ class MailBox {
     MailBox();			// Allocate and initialize mail box
     ~MailBox();			// De-allocate mail box
 
-    void Put(PacketHeader pktHdr, MailHeader mailHdr, char *data);
-   				// Atomically put a message into the mailbox
+    void Put(Mail *mail);	// Atomically put a message into the mailbox
     void Get(PacketHeader *pktHdr, MailHeader *mailHdr, char *data); 
    				// Atomically get a message out of the 
 				// mailbox (and wait if there is no message 
 				// to get!)
+    int GetMessage(PacketHeader *pktHdr, MailHeader *mailHdr, char *data,
+		int maxLength);
+				// Reassemble the fragments of the next
+				// message into "data", waiting for them
+				// to arrive; returns the message length,
+				// or -1 if it was longer than "maxLength"
+
   private:
-    SynchList *messages;	// A mailbox is just a list of arrived messages
+    Mail *Take(NetworkAddress from, MailBoxAddress fromBox, bool any);
+				// Wait for mail (from the given sender,
+				// unless "any"), and remove it
+
+    Mail *first;		// A mailbox is just a list of arrived messages
+    Mail *last;
+    Semaphore *mutex;		// Protects the list
+    Condition *arrived;		// Broadcast when mail is put in the box
 };
 
 // The following class defines a "Post Office", or a collection of 
@@ -105,6 +208,9 @@ class PostOffice {
 				// Allocate and initialize Post Office
 				//   "reliability" is how many packets
 				//   get dropped by the underlying network
+    PostOffice(NetworkAddress addr, Fabric *fabric, int nBoxes);
+				// Allocate and initialize the Post Office
+				// of one of the machines on "fabric"
     ~PostOffice();		// De-allocate Post Office data
     
     void Send(PacketHeader pktHdr, MailHeader mailHdr, char *data);
@@ -117,6 +223,25 @@ class PostOffice {
     				// Retrieve a message from "box".  Wait if
 				// there is no message in the box.
 
+    void SendMessage(PacketHeader pktHdr, MailHeader mailHdr, char *data);
+				// Send a message of any length, in
+				// as many fragments as it takes
+    int ReceiveMessage(int box, PacketHeader *pktHdr, MailHeader *mailHdr, 
+		char *data, int maxLength);
+				// Wait for the next message sent to "box"
+				// with SendMessage; returns its length,
+				// or -1 if it did not fit
+
+    void SendReliable(PacketHeader pktHdr, MailHeader mailHdr, char *data);
+				// Send mail that is sure to get there;
+				// returns as soon as it is in the window
+    void WaitForAcks(NetworkAddress to);
+				// Wait until everything sent reliably to
+				// "to" has been acknowledged
+    void SetReliability(double reliability);
+				// Change how many of our packets the
+				// network drops
+
     void PostalDelivery();	// Wait for incoming messages, 
 				// and then put them in the correct mailbox
 
@@ -127,15 +252,50 @@ class PostOffice {
    				// packet has arrived and can be pulled
 				// off of network (i.e., time to call 
 				// PostalDelivery)
+    void RetransmitAlarm();	// Interrupt handler, called when some
+				// packets may have to be sent again
 
   private:
+    void Initialize(NetworkAddress addr, int nBoxes);
+				// Set up everything but the network
+
+    int GetBuffer();		// Wait for a free transmit buffer
+    void Transmit(PacketHeader pktHdr, int buffer);
+				// Queue the packet in a transmit buffer
+				// to be put on the network
+    void StartSending();	// Put the next queued packet on the 
+				// network, if it isn't busy
+    Connection *Peer(NetworkAddress addr);
+				// Reliable delivery state for "addr"
+    bool Accept(NetworkAddress from, unsigned seq);
+				// Acknowledge reliable data; is it new?
+    void Acknowledged(NetworkAddress from, unsigned seq);
+				// Slide the window to "from" forward
+    void Retransmit();		// Send again whatever has timed out
+    void StartTimer(int when);	// Make sure RetransmitAlarm is called
+				// by time "when"
+
     Network *network;		// Physical network connection
     NetworkAddress netAddr;	// Network address of this machine
     MailBox *boxes;		// Table of mail boxes to hold incoming mail
     int numBoxes;		// Number of mail boxes
     Semaphore *messageAvailable;// V'ed when message has arrived from network
-    Semaphore *messageSent;	// V'ed when next message can be sent to network
-    Lock *sendLock;		// Only one outgoing message at a time
+    char outBuffers[TransmitBuffers][MaxPacketSize];
+				// Queue of packets to put on the network
+    PacketHeader outHeaders[TransmitBuffers];
+    bool outReady[TransmitBuffers]; // Has the packet been filled in?
+    int outHead;		// Next packet to put on the network
+    int outTail;		// Next buffer to hand out
+    bool sending;		// Is the network busy with outHead?
+    Semaphore *freeBuffers;	// V'ed when a transmit buffer is free
+    unsigned nextMessageId;	// Id for the next SendMessage
+    Connection **peers;		// Reliable delivery state, by machine;
+				// NULL until we talk to the machine
+    Semaphore *transportLock;	// Protects the send windows in "peers"
+    Condition *acked;		// Broadcast when the window slides
+    bool timeoutDue;		// Set by RetransmitAlarm
+    int timerAt;		// When RetransmitAlarm is next due; 0 if
+				// it isn't
 };
 
 #endif
@@ -0,0 +1,49 @@
+#include "syscall.h"
+
+/* Queues a batch of prints on the syscall ring and submits them all
+ * with a single RingEnter, then checks the completions.
+ */
+
+static void
+Submit (IoRing *ring, int opcode, int arg1, int arg2, int userData)
+{
+  RingSubmission *sqe = &ring->sq[ring->sqTail % RING_SIZE];
+
+  sqe->opcode = opcode;
+  sqe->arg1 = arg1;
+  sqe->arg2 = arg2;
+  sqe->userData = userData;
+  ring->sqTail++;
+}
+
+int
+main()
+{
+  IoRing *ring = RingSetup();
+  int i, done, errors = 0;
+
+  Submit(ring, RING_OP_PRINTSTRING, (int)"Hello from the ring: ", 0, 0);
+  for (i = 0; i < 10; i++)
+    Submit(ring, RING_OP_PRINTCHAR, '0'+i, 0, i+1);
+  Submit(ring, RING_OP_PRINTCHAR, '\n', 0, 11);
+  Submit(ring, RING_OP_SLEEP, 100, 0, 12);
+  Submit(ring, 1000, 0, 0, 13);		/* bad opcode, must fail */
+
+  done = RingEnter();
+  PrintString("Requests consumed: ");
+  PrintInt(done);
+  PrintChar('\n');
+
+  i = 0;
+  while (ring->cqHead != ring->cqTail) {
+    RingCompletion *cqe = &ring->cq[ring->cqHead % RING_SIZE];
+    if (cqe->userData != i) errors++;
+    if ((cqe->userData == 13) != (cqe->result == -1)) errors++;
+    ring->cqHead++;
+    i++;
+  }
+  PrintString("Completion errors: ");
+  PrintInt(errors);
+  PrintChar('\n');
+  return 0;
+}
@@ -266,6 +266,22 @@ ShmAllocate:
 	j       $31
 	.end ShmAllocate
 
+	.globl RingSetup
+	.ent    RingSetup
+RingSetup:
+	addiu $2,$0,SC_RingSetup
+	syscall
+	j       $31
+	.end RingSetup
+
+	.globl RingEnter
+	.ent    RingEnter
+RingEnter:
+	addiu $2,$0,SC_RingEnter
+	syscall
+	j       $31
+	.end RingEnter
+
 /* dummy function to keep gcc happy */
         .globl  __main
         .ent    __main
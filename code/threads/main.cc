@@ -11,7 +11,8 @@
 // Usage: nachos -d <debugflags> -rs <random seed #>
 //		-s -x <nachos file> -c <consoleIn> <consoleOut>
 //		-f -cp <unix file> <nachos file>
-//		-p <nachos file> -r <nachos file> -l -D -t
+//		-p <nachos file> -r <nachos file> -l -D -t -ds
+//		-md <nachos dir> -rd <nachos dir> -dt -jc <n> -ck -ra
 //              -n <network reliability> -m <machine id>
 //              -o <other machine id>
 //              -z
@@ -24,20 +25,43 @@
 //    -s causes user programs to be executed in single-step mode
 //    -x runs a user program
 //    -c tests the console
+//    -A selects the scheduling algorithm, -q its time slice in ticks,
+//       -alpha and -tau the SJF burst estimate weight and first guess,
+//       and -aq lets the slice of CPU-bound threads grow
+//    -F runs the batch of user programs listed in a file
+//    -j <n> splits the -F batch over n independent simulations, each
+//       in its own host process, and prints aggregate statistics
+//    -S <batch file> <algorithms> <quanta> <alphas> <replacement policies>
+//       runs the batch for every combination of the comma separated
+//       values (policy 0 means no demand paging), up to -j runs at a
+//       time, and prints one CSV row per run
 //
 //  FILESYS
 //    -f causes the physical disk to be formatted
 //    -cp copies a file from UNIX to Nachos
 //    -p prints a Nachos file to stdout
 //    -r removes a Nachos file from the file system
+//    -md creates a Nachos directory; -rd removes an empty one
 //    -l lists the contents of the Nachos directory
 //    -D prints the contents of the entire file system 
 //    -t tests the performance of the Nachos file system
+//    -ds compares FIFO and C-LOOK disk scheduling with concurrent readers
+//    -dt compares file operations in a flat and a nested directory tree
+//    -ra compares sequential reads with and without read ahead
+//    -bc <n> caches n disk sectors (0 turns the cache off)
+//    -jc <n> simulates a crash during the nth disk write; run again
+//       without -f, and with -ck, to see the journal recover the disk
+//       (e.g. "nachos -f -jc 40 -dt", then "nachos -ck")
+//    -ck checks that the file system is consistent
 //
 //  NETWORK
 //    -n sets the network reliability
 //    -m sets this machine's host id (needed for the network)
 //    -o runs a simple test of the Nachos network software
+//    -om runs the same test with messages too big for one packet
+//    -or measures reliable delivery as the network gets less reliable
+//    -of <n> <r> elects a leader among n machines, all simulated here,
+//       over links with reliability r
 //
 //  NOTE -- flags are ignored until the relevant assignment.
 //  Some of the flags are interpreted here; some in system.cc.
@@ -58,10 +82,16 @@
 
 extern void ThreadTest(void), Copy(char *unixFile, char *nachosFile);
 extern void Print(char *file), PerformanceTest(void);
+extern void DiskSchedulerTest(void), DirectoryTest(void), ReadAheadTest(void);
 extern void StartProcess(char *file), ConsoleTest(char *in, char *out);
-extern void MailTest(int networkID);
+extern void MailTest(int networkID), MessageTest(int networkID);
+extern void ReliableTest(int networkID);
+extern void FabricTest(int machines, double reliability);
 
 extern void ReadInputAndFork(char *file);
+extern void ReadInputAndForkParallel(char *file, int instances);
+extern void SweepBatch(char *file, char *algos, char *quanta, char *alphas,
+			char *policies, int jobs);
 
 //----------------------------------------------------------------------
 // main
@@ -84,6 +114,9 @@ main(int argc, char **argv)
 					// for a particular command
 
     int schedPriority = MAX_NICE_PRIORITY;
+#ifdef USER_PROGRAM
+    int batchInstances = 1;		// host processes used by -F
+#endif
     //
     for(int i = 0; i < NumPhysPages; i++)
       {
@@ -112,14 +145,35 @@ main(int argc, char **argv)
            argCount = 2;
            ASSERT((schedulingAlgo > 0) && (schedulingAlgo <= 4));
            if ((schedulingAlgo == ROUND_ROBIN) || (schedulingAlgo == UNIX_SCHED)) {
-              ASSERT (SCHED_QUANTUM > 0);
+              ASSERT (schedQuantum > 0);
            }
+           StartQuantum(currentThread);
            if (schedulingAlgo == UNIX_SCHED) {
               currentThread->SetBasePriority(schedPriority+DEFAULT_BASE_PRIORITY);
               currentThread->SetPriority(schedPriority+DEFAULT_BASE_PRIORITY);
               currentThread->SetUsage(0);
            }
         }
+        else if (!strcmp(*argv, "-q")) {	// time slice for -A 3 and 4
+           schedQuantum = atoi(*(argv + 1));
+           argCount = 2;
+           ASSERT(schedQuantum > 0);
+           currentThread->SetQuantum(schedQuantum);
+           StartQuantum(currentThread);	// rearm a slice -A started
+        }
+        else if (!strcmp(*argv, "-alpha")) {	// SJF burst estimate weight
+           sjfAlpha = atof(*(argv + 1));
+           argCount = 2;
+           ASSERT((sjfAlpha >= 0) && (sjfAlpha <= 1));
+        }
+        else if (!strcmp(*argv, "-tau")) {	// first SJF burst estimate
+           initialTau = atoi(*(argv + 1));
+           argCount = 2;
+           ASSERT(initialTau >= 0);
+        }
+        else if (!strcmp(*argv, "-aq")) {	// adaptive time slice
+           adaptiveQuantum = TRUE;
+        }
         else if(!strcmp(*argv, "-R")){
           replaceAlgo = atoi(*(argv + 1));
           ASSERT(replaceAlgo > 0 && replaceAlgo < 5);
@@ -147,10 +201,23 @@ main(int argc, char **argv)
 	    interrupt->Halt();		// once we start the console, then 
 					// Nachos will loop forever waiting 
 					// for console input
+	} else if (!strcmp(*argv, "-j")) {	// split -F over host processes
+            ASSERT (argc > 1);
+            batchInstances = atoi(*(argv + 1));
+            ASSERT (batchInstances > 0);
+            argCount = 2;
 	} else if (!strcmp(*argv, "-F")) {	// test multiprogramming
             ASSERT (argc > 1);
-            ReadInputAndFork(*(argv + 1));
+            if (batchInstances > 1)
+               ReadInputAndForkParallel(*(argv + 1), batchInstances);
+            else
+               ReadInputAndFork(*(argv + 1));
             argCount = 2;
+	} else if (!strcmp(*argv, "-S")) {	// sweep scheduler parameters
+            ASSERT (argc > 5);
+            SweepBatch(*(argv + 1), *(argv + 2), *(argv + 3), *(argv + 4),
+                       *(argv + 5), batchInstances);
+            argCount = 6;
         }
 #endif // USER_PROGRAM
 #ifdef FILESYS
@@ -166,12 +233,28 @@ main(int argc, char **argv)
 	    ASSERT(argc > 1);
 	    fileSystem->Remove(*(argv + 1));
 	    argCount = 2;
+	} else if (!strcmp(*argv, "-md")) {	// make Nachos directory
+	    ASSERT(argc > 1);
+	    fileSystem->Mkdir(*(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-rd")) {	// remove Nachos directory
+	    ASSERT(argc > 1);
+	    fileSystem->Rmdir(*(argv + 1));
+	    argCount = 2;
 	} else if (!strcmp(*argv, "-l")) {	// list Nachos directory
             fileSystem->List();
 	} else if (!strcmp(*argv, "-D")) {	// print entire filesystem
             fileSystem->Print();
 	} else if (!strcmp(*argv, "-t")) {	// performance test
             PerformanceTest();
+	} else if (!strcmp(*argv, "-ds")) {	// disk scheduler test
+            DiskSchedulerTest();
+	} else if (!strcmp(*argv, "-dt")) {	// directory test
+            DirectoryTest();
+	} else if (!strcmp(*argv, "-ck")) {	// check file system
+            fileSystem->Check();
+	} else if (!strcmp(*argv, "-ra")) {	// read ahead test
+            ReadAheadTest();
 	}
 #endif // FILESYS
 #ifdef NETWORK
@@ -182,6 +265,20 @@ main(int argc, char **argv)
 						// start up another nachos
             MailTest(atoi(*(argv + 1)));
             argCount = 2;
+        } else if (!strcmp(*argv, "-om")) {
+	    ASSERT(argc > 1);
+            Delay(2);
+            MessageTest(atoi(*(argv + 1)));
+            argCount = 2;
+        } else if (!strcmp(*argv, "-or")) {
+	    ASSERT(argc > 1);
+            Delay(2);
+            ReliableTest(atoi(*(argv + 1)));
+            argCount = 2;
+        } else if (!strcmp(*argv, "-of")) {
+	    ASSERT(argc > 2);
+            FabricTest(atoi(*(argv + 1)), atof(*(argv + 2)));
+            argCount = 3;
         }
 #endif // NETWORK
     }
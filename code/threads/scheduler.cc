@@ -72,7 +72,7 @@ Scheduler::ReadyToRun (Thread *thread)
           }
           else if (schedulingAlgo == NON_PREEMPTIVE_SJF) {
              stats->burstEstimateError += abs(stats->totalTicks - cpu_burst_start_time - thread->GetPriority());
-             thread->SetPriority((int)(ALPHA*(stats->totalTicks - cpu_burst_start_time) + (1-ALPHA)*thread->GetPriority()));
+             thread->SetPriority((int)(sjfAlpha*(stats->totalTicks - cpu_burst_start_time) + (1-sjfAlpha)*thread->GetPriority()));
           }
        }
     }
@@ -125,12 +125,14 @@ Scheduler::Run (Thread *nextThread)
     
     cpu_burst_start_time = stats->totalTicks;
     nextThread->SetCPUBurstStartTime(cpu_burst_start_time);
+    StartQuantum(nextThread);
     stats->total_wait_time += (stats->totalTicks - nextThread->GetWaitStartTime());
 
 #ifdef USER_PROGRAM			// ignore until running user programs 
     if (currentThread->space != NULL) {	// if this thread is a user program,
         currentThread->SaveUserState(); // save the user's CPU registers
-	currentThread->space->SaveState();
+	if (nextThread->space != currentThread->space)
+	    currentThread->space->SaveState();
     }
 #endif
     
@@ -162,10 +164,8 @@ Scheduler::Run (Thread *nextThread)
     }
     
 #ifdef USER_PROGRAM
-    if (currentThread->space != NULL) {		// if there is an address space
-        currentThread->RestoreUserState();     // to restore, do it.
-	currentThread->space->RestoreState();
-    }
+    if (currentThread->space != NULL)		// if there is an address space
+        RestoreUserContext();			// to restore, do it.
 #endif
 }
 
@@ -191,13 +191,40 @@ Scheduler::Tail ()
     }
 
 #ifdef USER_PROGRAM
-    if (currentThread->space != NULL) {         // if there is an address space
-        currentThread->RestoreUserState();     // to restore, do it.
-        currentThread->space->RestoreState();
-    }
+    if (currentThread->space != NULL)		// if there is an address space
+        RestoreUserContext();			// to restore, do it.
 #endif
 }
 
+#ifdef USER_PROGRAM
+//----------------------------------------------------------------------
+// Scheduler::RestoreUserContext
+//      Load the user registers and page table of currentThread, which
+//      has just been given the CPU.  Either may still be in the machine
+//      -- when we switched to a kernel thread and straight back, say,
+//      or between threads sharing an address space -- and then there
+//      is nothing to copy.
+//----------------------------------------------------------------------
+
+void
+Scheduler::RestoreUserContext ()
+{
+    AddrSpace *space = currentThread->space;
+
+    if (currentThread->RestoreUserState()) stats->numRegisterLoads++;
+    else stats->numRegisterLoadsSkipped++;
+
+    if ((machine->pageTable == space->GetPageTable())
+        && (machine->pageTableSize == space->GetNumPages())) {
+       stats->numSpaceLoadsSkipped++;
+    }
+    else {
+       space->RestoreState();
+       stats->numSpaceLoads++;
+    }
+}
+#endif
+
 //----------------------------------------------------------------------
 // Scheduler::Print
 // 	Print the scheduler state -- in other words, the contents of
@@ -223,10 +250,10 @@ Scheduler::SetEmptyReadyQueueStartTime (int ticks)
 void
 Scheduler::UpdateThreadPriority (void)
 {
-   unsigned i;
+   int i;
+   Thread *thread;
    int this_cpu_burst_duration = stats->totalTicks - cpu_burst_start_time;
    ASSERT(this_cpu_burst_duration > 0);
-   unsigned currentPID = currentThread->GetPID();
 
    // First we update the currentThread priority
 
@@ -238,14 +265,14 @@ Scheduler::UpdateThreadPriority (void)
 
    // Update everybody else
 
-   for (i=0; i<thread_index; i++) {
-      if ((i != currentPID) && !exitThreadArray[i]) {
-         ASSERT(threadArray[i] != NULL);
-         currentThreadUsage = threadArray[i]->GetUsage();
+   for (i=0; i<threadTable->NumLive(); i++) {
+      thread = threadTable->Live(i);
+      if (thread != currentThread) {
+         currentThreadUsage = thread->GetUsage();
          currentThreadUsage = currentThreadUsage >> 1;
-         currentThreadPriority = threadArray[i]->GetBasePriority() + (currentThreadUsage >> 1);
-         threadArray[i]->SetUsage(currentThreadUsage);
-         threadArray[i]->SetPriority(currentThreadPriority);
+         currentThreadPriority = thread->GetBasePriority() + (currentThreadUsage >> 1);
+         thread->SetUsage(currentThreadUsage);
+         thread->SetPriority(currentThreadPriority);
       }
    }
 }
@@ -35,6 +35,9 @@ class Scheduler {
     void UpdateThreadPriority (void);	// Used by the UNIX scheduler
    
   private:
+    void RestoreUserContext();		// Reload the user state of
+					// currentThread after a switch
+
     List *readyList;  		// queue of threads that are ready to run,
 				// but not running
 
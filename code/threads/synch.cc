@@ -144,7 +144,7 @@ void Condition::Broadcast() {
     Thread *thread;
     IntStatus oldLevel = interrupt->SetLevel(IntOff);
 
-    while (queue->IsEmpty()) {
+    while (!queue->IsEmpty()) {
         thread = (Thread *)queue->Remove();
         if (thread != NULL)
             scheduler->ReadyToRun(thread);
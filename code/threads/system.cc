@@ -21,14 +21,16 @@ Timer *timer;				// the hardware timer device,
 
 unsigned numPagesAllocated;              // number of physical frames allocated
 
-Thread *threadArray[MAX_THREAD_COUNT];  // Array of thread pointers
-unsigned thread_index;			// Index into this array (also used to assign unique pid)
+ThreadTable *threadTable;		// every thread, by pid
 bool initializedConsoleSemaphores;
-bool exitThreadArray[MAX_THREAD_COUNT];  //Marks exited threads
 
 TimeSortedWaitQueue *sleepQueueHead;	// Needed to implement SC_Sleep
 
 int schedulingAlgo;			// Scheduling algorithm to simulate
+int schedQuantum = DEFAULT_SCHED_QUANTUM;	// Time slice for preemptive algorithms
+float sjfAlpha = DEFAULT_ALPHA;		// Burst estimate weight for SJF
+int initialTau = INITIAL_TAU;		// First burst estimate for SJF
+bool adaptiveQuantum = FALSE;		// Grow the slice of CPU-bound threads
 char **batchProcesses;			// Names of batch processes
 int *priority;				// Process priority
 Semaphore* semaphoreMap[100];
@@ -38,7 +40,6 @@ Condition* conditionMap[100];
 int conditionKeyIndexMap[100];
 
 int cpu_burst_start_time;        // Records the start of current CPU burst
-int completionTimeArray[MAX_THREAD_COUNT];        // Records the completion time of all simulated threads
 bool excludeMainThread;		// Used by completion time statistics calculation
 List *PPageQueue = new List;
 #ifdef FILESYS_NEEDED
@@ -51,6 +52,7 @@ SynchDisk   *synchDisk;
 
 #ifdef USER_PROGRAM	// requires either FILESYS or FILESYS_STUB
 Machine *machine;	// user program memory and registers
+int batchReportFd = -1;	// set in instances started by -j
 #endif
 
 #ifdef NETWORK
@@ -97,13 +99,43 @@ TimerInterruptHandler(int dummy)
          delete ptr;
      }
         //printf("[%d] Timer interrupt.\n", stats->totalTicks);
-     if ((schedulingAlgo == ROUND_ROBIN) || (schedulingAlgo == UNIX_SCHED)) {
-         if ((stats->totalTicks - cpu_burst_start_time) >= SCHED_QUANTUM) {
-          ASSERT(cpu_burst_start_time == currentThread->GetCPUBurstStartTime());
-          interrupt->YieldOnReturn();
-      }
-  }
+        // Time slices are enforced by the alarm (see StartQuantum)
+}
 }
+
+//----------------------------------------------------------------------
+// QuantumExpiredHandler
+// 	Interrupt handler for the timer alarm armed by StartQuantum.  The
+//	running thread has used up its time slice, so preempt it as
+//	TimerInterruptHandler would.  With an adaptive quantum, a thread
+//	that keeps running to the end of its slice is CPU bound and gets
+//	twice the slice next time, to cut down on context switches.
+//----------------------------------------------------------------------
+static void
+QuantumExpiredHandler(int dummy)
+{
+    if (interrupt->getStatus() == IdleMode) return;
+    ASSERT(cpu_burst_start_time == currentThread->GetCPUBurstStartTime());
+    if (adaptiveQuantum && (currentThread->GetQuantum() < MAX_QUANTUM_SCALE*schedQuantum)) {
+       currentThread->SetQuantum(2*currentThread->GetQuantum());
+    }
+    interrupt->YieldOnReturn();
+}
+
+//----------------------------------------------------------------------
+// StartQuantum
+// 	Called when "thread" starts a CPU burst.  For the preemptive
+//	algorithms, have the timer interrupt exactly when its slice ends,
+//	rather than at the next TimerTicks boundary after that.
+//----------------------------------------------------------------------
+void
+StartQuantum(Thread *thread)
+{
+    if ((schedulingAlgo == ROUND_ROBIN) || (schedulingAlgo == UNIX_SCHED)) {
+       timer->SetAlarm(QuantumExpiredHandler, 0,
+                       adaptiveQuantum ? thread->GetQuantum() : schedQuantum);
+    }
+    else timer->CancelAlarm();
 }
 
 //----------------------------------------------------------------------
@@ -144,8 +176,7 @@ ASSERT(priority != NULL);
 
 excludeMainThread = FALSE;
 
-for (i=0; i<MAX_THREAD_COUNT; i++) { threadArray[i] = NULL; exitThreadArray[i] = false; completionTimeArray[i] = -1; }
-    thread_index = 0;
+threadTable = new ThreadTable();
 
 sleepQueueHead = NULL;
 
@@ -155,6 +186,11 @@ sleepQueueHead = NULL;
 #ifdef FILESYS_NEEDED
     bool format = FALSE;	// format disk
 #endif
+#ifdef FILESYS
+    int cacheSectors = DefaultCacheSectors;	// size of the disk cache
+    int crashWrites = 0;			// disk writes until a simulated
+						// crash, if any
+#endif
 #ifdef NETWORK
     double rely = 1;		// network reliability
     int netname = 0;		// UNIX socket name
@@ -184,6 +220,17 @@ sleepQueueHead = NULL;
    if (!strcmp(*argv, "-f"))
        format = TRUE;
 #endif
+#ifdef FILESYS
+   if (!strcmp(*argv, "-bc")) {
+       ASSERT(argc > 1);
+       cacheSectors = atoi(*(argv + 1));
+       argCount = 2;
+   } else if (!strcmp(*argv, "-jc")) {
+       ASSERT(argc > 1);
+       crashWrites = atoi(*(argv + 1));
+       argCount = 2;
+   }
+#endif
 #ifdef NETWORK
    if (!strcmp(*argv, "-l")) {
        ASSERT(argc > 1);
@@ -223,7 +270,8 @@ sleepQueueHead = NULL;
 #endif
 
 #ifdef FILESYS
-    synchDisk = new SynchDisk("DISK");
+    synchDisk = new SynchDisk("DISK", cacheSectors);
+    synchDisk->CrashAfter(crashWrites);
 #endif
 
 #ifdef FILESYS_NEEDED
@@ -251,11 +299,16 @@ Cleanup()
     delete machine;
 #endif
 
+#ifdef FILESYS
+    synchDisk->Sync(TRUE);		// no more waiting for the disk
+#endif
+
 #ifdef FILESYS_NEEDED
-    delete fileSystem;
+    delete fileSystem;			// writes back file system metadata
 #endif
 
 #ifdef FILESYS
+    synchDisk->Sync(TRUE);
     delete synchDisk;
 #endif
     
@@ -16,7 +16,7 @@
 #include "stats.h"
 #include "timer.h"
 #include "synch.h"
-#define MAX_THREAD_COUNT 1000
+#include "threadtable.h"
 #define MAX_BATCH_SIZE 100
 
 // Scheduling algorithms
@@ -25,10 +25,11 @@
 #define ROUND_ROBIN 		3
 #define UNIX_SCHED		4
 
-#define SCHED_QUANTUM		100		// If not a multiple of timer interval, quantum will overshoot
+#define DEFAULT_SCHED_QUANTUM	100
+#define MAX_QUANTUM_SCALE	8		// Adaptive quantum grows up to this many quanta
 
 #define INITIAL_TAU		SystemTick	// Initial guess of the burst is set to the overhead of system activity
-#define ALPHA			0.5
+#define DEFAULT_ALPHA		0.5
 
 #define MAX_NICE_PRIORITY	100		// Default nice value (used by UNIX scheduler)
 #define MIN_NICE_PRIORITY	0		// Highest input priority
@@ -49,11 +50,14 @@ extern Statistics *stats;			// performance metrics
 extern Timer *timer;				// the hardware alarm clock
 extern unsigned numPagesAllocated;		// number of physical frames allocated
 
-extern Thread *threadArray[];  // Array of thread pointers
-extern unsigned thread_index;                  // Index into this array (also used to assign unique pid)
+extern ThreadTable *threadTable;		// every thread, by pid
 extern bool initializedConsoleSemaphores;	// Used to initialize the semaphores for console I/O exactly once
-extern bool exitThreadArray[];		// Marks exited threads
 extern int schedulingAlgo;		// Scheduling algorithm to simulate
+extern int schedQuantum;		// Time slice of ROUND_ROBIN and UNIX_SCHED
+extern float sjfAlpha;			// Weight of the last burst in the SJF estimate
+extern int initialTau;			// First SJF burst estimate of every thread
+extern bool adaptiveQuantum;		// Double the slice of threads that use it up
+extern void StartQuantum(Thread *thread);	// Arm the timer for a new CPU burst
 extern char **batchProcesses;		// Names of batch executables
 extern int *priority;			// Process priority
 extern Semaphore* semaphoreMap[];
@@ -61,7 +65,6 @@ extern int semaphoreKeyIndexMap[];
 extern Condition* conditionMap[];
 extern int conditionKeyIndexMap[];
 extern int cpu_burst_start_time;	// Records the start of current CPU burst
-extern int completionTimeArray[];	// Records the completion time of all simulated threads
 extern bool excludeMainThread;		// Used by completion time statistics calculation
 
 //extern int pageMap[];
@@ -104,6 +107,9 @@ extern TimeSortedWaitQueue *sleepQueueHead;
 #ifdef USER_PROGRAM
 #include "machine.h"
 extern Machine* machine;	// user program memory and registers
+extern int batchReportFd;	// Where a parallel batch instance reports
+				// its statistics, -1 if not one
+extern void ReportBatchInstance(int maxCompletion, float avgCompletion);
 #endif
 
 #ifdef FILESYS_NEEDED 		// FILESYS or FILESYS_STUB 
@@ -23,6 +23,14 @@
 #define STACK_FENCEPOST 0xdeadbeef	// this is put at the top of the
 					// execution stack, for detecting 
 					// stack overflows
+
+// Stacks of deleted threads, guard pages and all, waiting to be reused.
+// Allocating a stack costs two host system calls to protect the guard
+// pages, and freeing it two more, so a program that forks many short
+// threads saves a lot by keeping a few around.
+
+static int *stackPool[StackPoolSize];
+static int stackPoolCount = 0;
 //----------------------------------------------------------------------
 // Thread::Thread
 // 	Initialize a thread control block, so that we can then call
@@ -44,11 +52,7 @@ Thread::Thread(char* threadName, int nice)
     space = NULL;
 #endif
 
-    threadArray[thread_index] = this;
-    pid = thread_index;
-    thread_index++;
-    stats->numTotalThreads = thread_index;
-    ASSERT(thread_index < MAX_THREAD_COUNT);
+    pid = threadTable->Add(this);
     if (currentThread != NULL) {
        ppid = currentThread->GetPID();
        currentThread->RegisterNewChild (pid);
@@ -56,9 +60,13 @@ Thread::Thread(char* threadName, int nice)
     else ppid = -1;
 
     childcount = 0;
+    childslots = INITIAL_CHILD_COUNT;
+    childpidArray = new int[childslots];
+    childexitcode = new int[childslots];
+    exitedChild = new bool[childslots];
     waitchild_id = -1;
 
-    for (i=0; i<MAX_CHILD_COUNT; i++) exitedChild[i] = false;
+    for (i=0; i<INITIAL_CHILD_COUNT; i++) exitedChild[i] = false;
     
     if (nice == GET_NICE_FROM_PARENT) {
        if (ppid != -1) {
@@ -73,8 +81,9 @@ Thread::Thread(char* threadName, int nice)
     }
     schedPriority = basePriority;
     usage = 0;
+    quantum = schedQuantum;
 
-    if (schedulingAlgo == NON_PREEMPTIVE_SJF) schedPriority = INITIAL_TAU;
+    if (schedulingAlgo == NON_PREEMPTIVE_SJF) schedPriority = initialTau;
 }
 
 //----------------------------------------------------------------------
@@ -91,11 +100,28 @@ Thread::Thread(char* threadName, int nice)
 
 Thread::~Thread()
 {
+    unsigned i;
+
     DEBUG('t', "Deleting thread \"%s\"\n", name);
 
     ASSERT(this != currentThread);
-    if (stack != NULL)
-	DeallocBoundedArray((char *) stack, StackSize * sizeof(int));
+
+    // Nobody is left to join with my children, so their pids can go
+    for (i=0; i<childcount; i++) threadTable->Release(childpidArray[i]);
+    threadTable->Remove(this);
+    delete [] childpidArray;
+    delete [] childexitcode;
+    delete [] exitedChild;
+
+#ifdef USER_PROGRAM
+    machine->ForgetRegisters(userRegisters);	// a new thread may get this memory
+#endif
+    if (stack != NULL) {
+	if (stackPoolCount < StackPoolSize)
+	    stackPool[stackPoolCount++] = stack;	// keep it for reuse
+	else
+	    DeallocBoundedArray((char *) stack, StackSize * sizeof(int));
+    }
 }
 
 //----------------------------------------------------------------------
@@ -187,6 +213,41 @@ Thread::Finish ()
     // not reached
 }
 
+//----------------------------------------------------------------------
+// Thread::RegisterNewChild
+//      Called by the constructor of a thread I am creating.  There is
+//      no limit on the number of children; the arrays describing them
+//      double in size when they fill up.
+//----------------------------------------------------------------------
+
+void
+Thread::RegisterNewChild (int childpid)
+{
+   unsigned i;
+
+   if (childcount == childslots) {
+      int *pids = new int[2*childslots];
+      int *codes = new int[2*childslots];
+      bool *exited = new bool[2*childslots];
+
+      for (i=0; i<childcount; i++) {
+         pids[i] = childpidArray[i];
+         codes[i] = childexitcode[i];
+         exited[i] = exitedChild[i];
+      }
+      for (; i<2*childslots; i++) exited[i] = false;
+      delete [] childpidArray;
+      delete [] childexitcode;
+      delete [] exitedChild;
+      childpidArray = pids;
+      childexitcode = codes;
+      exitedChild = exited;
+      childslots *= 2;
+   }
+   childpidArray[childcount] = childpid;
+   childcount++;
+}
+
 //----------------------------------------------------------------------
 // Thread::SetChildExitCode
 //      Called by an exiting thread on parent's thread object.
@@ -250,18 +311,18 @@ Thread::Exit (bool terminateSim, int exitcode)
           }
           else if (schedulingAlgo == NON_PREEMPTIVE_SJF) {
              stats->burstEstimateError += abs(stats->totalTicks - cpu_burst_start_time - schedPriority);
-             schedPriority = (int)(ALPHA*(stats->totalTicks - cpu_burst_start_time) + (1-ALPHA)*schedPriority);
+             schedPriority = (int)(sjfAlpha*(stats->totalTicks - cpu_burst_start_time) + (1-sjfAlpha)*schedPriority);
           }
        }
     }
     status = BLOCKED;
-    completionTimeArray[currentThread->GetPID()] = stats->totalTicks;
+    threadTable->Completed(this, stats->totalTicks);
 
     // Set exit code in parent's structure provided the parent hasn't exited
     if (ppid != -1) {
-       if (!exitThreadArray[ppid]) {
-          ASSERT(threadArray[ppid] != NULL);
-          threadArray[ppid]->SetChildExitCode (pid, exitcode);
+       if (!threadTable->HasExited(ppid)) {
+          ASSERT(threadTable->Lookup(ppid) != NULL);
+          threadTable->Lookup(ppid)->SetChildExitCode (pid, exitcode);
        }
     }
 
@@ -335,6 +396,7 @@ Thread::Yield ()
        }
        cpu_burst_start_time = stats->totalTicks;
        SetCPUBurstStartTime(cpu_burst_start_time);
+       StartQuantum(this);
     }
     (void) interrupt->SetLevel(oldLevel);
 }
@@ -368,6 +430,9 @@ Thread::Sleep ()
     
     DEBUG('t', "Sleeping thread \"%s\"\n", getName());
 
+    // Blocking before the slice ran out marks the thread as I/O bound
+    quantum = schedQuantum;
+
     if (status == RUNNING) {
        stats->cpu_time += (stats->totalTicks - cpu_burst_start_time);
        if ((stats->totalTicks - cpu_burst_start_time) > 0) {
@@ -384,7 +449,7 @@ Thread::Sleep ()
           }
           else if (schedulingAlgo == NON_PREEMPTIVE_SJF) {
              stats->burstEstimateError += abs(stats->totalTicks - cpu_burst_start_time - schedPriority);
-             schedPriority = (int)(ALPHA*(stats->totalTicks - cpu_burst_start_time) + (1-ALPHA)*schedPriority);
+             schedPriority = (int)(sjfAlpha*(stats->totalTicks - cpu_burst_start_time) + (1-sjfAlpha)*schedPriority);
           }
        }
     }
@@ -421,6 +486,9 @@ void ThreadPrint(int arg){ Thread *t = (Thread *)arg; t->Print(); }
 //		calls (*func)(arg)
 //		calls Thread::Finish
 //
+//	The stack of a deleted thread is used if there is one; it is
+//	already bounded by guard pages.
+//
 //	"func" is the procedure to be forked
 //	"arg" is the parameter to be passed to the procedure
 //----------------------------------------------------------------------
@@ -428,7 +496,13 @@ void ThreadPrint(int arg){ Thread *t = (Thread *)arg; t->Print(); }
 void
 Thread::StackAllocate (VoidFunctionPtr func, int arg)
 {
-    stack = (int *) AllocBoundedArray(StackSize * sizeof(int));
+    if (stackPoolCount > 0) {
+	stack = stackPool[--stackPoolCount];
+	stats->numStacksReused++;
+    } else {
+	stack = (int *) AllocBoundedArray(StackSize * sizeof(int));
+	stats->numStacksAllocated++;
+    }
 
 #ifdef HOST_SNAKE
     // HP stack works from low addresses to high addresses
@@ -474,8 +548,7 @@ Thread::StackAllocate (VoidFunctionPtr func, int arg)
 void
 Thread::SaveUserState()
 {
-    for (int i = 0; i < NumTotalRegs; i++)
-	userRegisters[i] = machine->ReadRegister(i);
+    machine->SaveRegisters(userRegisters);
 }
 
 //----------------------------------------------------------------------
@@ -485,13 +558,15 @@ Thread::SaveUserState()
 //	Note that a user program thread has *two* sets of CPU registers -- 
 //	one for its state while executing user code, one for its state 
 //	while executing kernel code.  This routine restores the former.
+//
+//	Returns FALSE, having copied nothing, if the machine registers
+//	have not been touched since this thread's were saved.
 //----------------------------------------------------------------------
 
-void
+bool
 Thread::RestoreUserState()
 {
-    for (int i = 0; i < NumTotalRegs; i++)
-	machine->WriteRegister(i, userRegisters[i]);
+    return machine->RestoreRegisters(userRegisters);
 }
 
 //----------------------------------------------------------------------
@@ -518,11 +593,16 @@ Thread::CheckIfChild (int childpid)
 // Thread::JoinWithChild
 //      Called by a thread as a result of SC_Join.
 //      Returns the exit code of the child being joined with.
+//
+//      Once joined, the child is forgotten and its pid may be reused,
+//      so joining with the same pid again fails.
 //----------------------------------------------------------------------
 
 int
 Thread::JoinWithChild (int whichchild)
 {
+   int ecode;
+
    // Has the child exited?
    if (!exitedChild[whichchild]) {
       // Put myself to sleep
@@ -533,7 +613,16 @@ Thread::JoinWithChild (int whichchild)
       printf("[pid %d] After sleep in JoinWithChild.\n", pid);
       (void) interrupt->SetLevel(oldLevel);
    }
-   return childexitcode[whichchild];
+   ecode = childexitcode[whichchild];
+
+   threadTable->Release(childpidArray[whichchild]);
+   childcount--;
+   childpidArray[whichchild] = childpidArray[childcount];
+   childexitcode[whichchild] = childexitcode[childcount];
+   exitedChild[whichchild] = exitedChild[childcount];
+   exitedChild[childcount] = false;
+
+   return ecode;
 }
 
 //----------------------------------------------------------------------
@@ -545,6 +634,7 @@ Thread::JoinWithChild (int whichchild)
 void
 Thread::ResetReturnValue ()
 {
+   machine->ForgetRegisters(userRegisters);	// no longer what was saved
    userRegisters[2] = 0;
 }
 
@@ -37,7 +37,7 @@
 #ifndef THREAD_H
 #define THREAD_H
 
-#define MAX_CHILD_COUNT 100
+#define INITIAL_CHILD_COUNT 8	// child slots; doubled as needed
 
 #include "copyright.h"
 #include "utility.h"
@@ -57,6 +57,10 @@
 // WATCH OUT IF THIS ISN'T BIG ENOUGH!!!!!
 #define StackSize	(4 * 1024)	// in words
 
+// Stacks of threads that have been deleted are kept, up to this many,
+// for new threads to use.
+#define StackPoolSize	32
+
 
 // Thread state
 enum ThreadStatus { JUST_CREATED, RUNNING, READY, BLOCKED };
@@ -114,6 +118,7 @@ class Thread {
 
     inline int GetPID (void) { return pid; }
     inline int GetPPID (void) { return ppid; }
+    void Orphan (void) { ppid = -1; }			// My parent will never join with me
 
     void SetChildExitCode (int childpid, int exitcode);	// Called by an exiting child thread
 
@@ -122,7 +127,7 @@ class Thread {
 
     int JoinWithChild (int whichchild);			// Called by SC_Join
 
-    void RegisterNewChild (int childpid) { childpidArray[childcount] = childpid; childcount++; ASSERT(childcount < MAX_CHILD_COUNT); }
+    void RegisterNewChild (int childpid);		// Called by the constructor of a new child thread
 
     void ResetReturnValue ();				// Used by SC_Fork to set the return value of child to zero
     void Schedule ();					// Called by SC_Fork to enqueue the newly created child thread in the ready queue
@@ -149,6 +154,9 @@ class Thread {
     void SetUsage (int usage);
     int GetUsage (void);
 
+    void SetQuantum (int q) { quantum = q; }
+    int GetQuantum (void) { return quantum; }
+
   private:
     // some of the private data for this class is listed above
     
@@ -161,16 +169,19 @@ class Thread {
 
     int pid, ppid;			// My pid and my parent's pid
 
-    int childpidArray[MAX_CHILD_COUNT];	// My children
-    int childexitcode[MAX_CHILD_COUNT];	// Exit code of my children (return values for Join calls)
-    bool exitedChild[MAX_CHILD_COUNT];	// Which children have exited?
+    int *childpidArray;			// My children
+    int *childexitcode;			// Exit code of my children (return values for Join calls)
+    bool *exitedChild;			// Which children have exited?
     unsigned childcount;		// Count of children
+    unsigned childslots;		// Size of the three arrays above
 
     int waitchild_id;			// Child I am waiting on (as a result of a Join call)
 
     int wait_start_time;		// Start tick of wait in ready queue
     int burst_start_time;		// Start of the current CPU burst
 
+    int quantum;			// Time slice, grows for CPU-bound threads
+					// if the quantum is adaptive
     int basePriority, schedPriority, usage;	// Used by the UNIX scheduler
 						// schedPriority is also used to store the next burst estimate
 
@@ -183,7 +194,8 @@ class Thread {
 
   public:
     void SaveUserState();		// save user-level register state
-    void RestoreUserState();		// restore user-level register state
+    bool RestoreUserState();		// restore user-level register state;
+					// FALSE if it was still in the machine
 
     AddrSpace *space;			// User code this thread is running.
     
@@ -0,0 +1,304 @@
+// threadtable.cc
+//	Routines to hand out, look up and recycle process ids.
+//
+//	Free pids are kept on a linked list threaded through "nextFree",
+//	so that allocating and freeing a pid is constant time.  Threads
+//	that have not called Exit are kept in "live"; when one leaves,
+//	the last entry is moved into its slot.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "threadtable.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// ThreadTable::ThreadTable
+// 	Initialize an empty table.  Pids are handed out lowest first,
+//	so the main thread is pid 0.
+//----------------------------------------------------------------------
+
+ThreadTable::ThreadTable()
+{
+    size = 0;
+    threads = NULL;
+    exited = NULL;
+    inUse = NULL;
+    nextFree = NULL;
+    freeList = -1;
+    liveIndex = NULL;
+    live = NULL;
+    numLive = 0;
+
+    numCreated = 0;
+    first = NULL;
+    firstCompleted = FALSE;
+    firstCompletion = -1;
+    numCompleted = 0;
+    completionSum = completionSquares = 0;
+    completionMax = 0;
+    completionMin = 0;
+
+    Grow();
+}
+
+//----------------------------------------------------------------------
+// ThreadTable::~ThreadTable
+// 	De-allocate the table.  The threads themselves are not ours to
+//	delete.
+//----------------------------------------------------------------------
+
+ThreadTable::~ThreadTable()
+{
+    delete [] threads;
+    delete [] exited;
+    delete [] inUse;
+    delete [] nextFree;
+    delete [] liveIndex;
+    delete [] live;
+}
+
+//----------------------------------------------------------------------
+// ThreadTable::Grow
+// 	Double the number of pids, copying over the old entries.  The
+//	new pids go on the free list lowest first.
+//----------------------------------------------------------------------
+
+void
+ThreadTable::Grow()
+{
+    int newSize = (size == 0) ? InitialThreadTableSize : 2 * size;
+    Thread **newThreads = new Thread*[newSize];
+    bool *newExited = new bool[newSize];
+    bool *newInUse = new bool[newSize];
+    int *newNextFree = new int[newSize];
+    int *newLiveIndex = new int[newSize];
+    Thread **newLive = new Thread*[newSize];
+    int i;
+
+    for (i = 0; i < size; i++) {
+	newThreads[i] = threads[i];
+	newExited[i] = exited[i];
+	newInUse[i] = inUse[i];
+	newNextFree[i] = nextFree[i];
+	newLiveIndex[i] = liveIndex[i];
+    }
+    for (i = 0; i < numLive; i++)
+	newLive[i] = live[i];
+    for (i = newSize - 1; i >= size; i--) {
+	newThreads[i] = NULL;
+	newExited[i] = FALSE;
+	newInUse[i] = FALSE;
+	newLiveIndex[i] = -1;
+	newNextFree[i] = freeList;
+	freeList = i;
+    }
+
+    delete [] threads;
+    delete [] exited;
+    delete [] inUse;
+    delete [] nextFree;
+    delete [] liveIndex;
+    delete [] live;
+    threads = newThreads;
+    exited = newExited;
+    inUse = newInUse;
+    nextFree = newNextFree;
+    liveIndex = newLiveIndex;
+    live = newLive;
+    size = newSize;
+}
+
+//----------------------------------------------------------------------
+// ThreadTable::Add
+// 	Give a newly created thread a pid, growing the table if every
+//	pid is taken.  Returns the pid.
+//----------------------------------------------------------------------
+
+int
+ThreadTable::Add(Thread *thread)
+{
+    int pid;
+
+    if (freeList == -1)
+	Grow();
+    pid = freeList;
+    freeList = nextFree[pid];
+
+    ASSERT(!inUse[pid]);
+    inUse[pid] = TRUE;
+    threads[pid] = thread;
+    exited[pid] = FALSE;
+    liveIndex[pid] = numLive;
+    live[numLive++] = thread;
+
+    if (numCreated == 0)
+	first = thread;
+    numCreated++;
+    stats->numTotalThreads = numCreated;
+    return pid;
+}
+
+//----------------------------------------------------------------------
+// ThreadTable::Unlink
+// 	Take a pid off the live array, if it is there, by moving the
+//	last live thread into its slot.
+//----------------------------------------------------------------------
+
+void
+ThreadTable::Unlink(int pid)
+{
+    int slot = liveIndex[pid];
+    Thread *last;
+
+    if (slot == -1)
+	return;
+    numLive--;
+    last = live[numLive];
+    live[slot] = last;
+    liveIndex[last->GetPID()] = slot;
+    liveIndex[pid] = -1;
+}
+
+//----------------------------------------------------------------------
+// ThreadTable::Free
+// 	Return a pid to the free list.
+//----------------------------------------------------------------------
+
+void
+ThreadTable::Free(int pid)
+{
+    ASSERT(inUse[pid] && (threads[pid] == NULL));
+    inUse[pid] = FALSE;
+    nextFree[pid] = freeList;
+    freeList = pid;
+}
+
+//----------------------------------------------------------------------
+// ThreadTable::Remove
+// 	Called when a thread is deleted.  If its parent might still
+//	join with it, the pid stays reserved until the parent calls
+//	Release; otherwise it can be reused right away.
+//----------------------------------------------------------------------
+
+void
+ThreadTable::Remove(Thread *thread)
+{
+    int pid = thread->GetPID();
+
+    ASSERT(threads[pid] == thread);
+    Unlink(pid);
+    threads[pid] = NULL;
+    if (thread == first)
+	first = NULL;
+    if (thread->GetPPID() == -1)
+	Free(pid);
+}
+
+//----------------------------------------------------------------------
+// ThreadTable::Release
+// 	Called by a parent that will never ask about child "pid" again,
+//	because it has joined with it or is being deleted itself.  A
+//	child that still exists becomes an orphan, and gives up its pid
+//	when it is deleted.
+//----------------------------------------------------------------------
+
+void
+ThreadTable::Release(int pid)
+{
+    if (threads[pid] != NULL)
+	threads[pid]->Orphan();
+    else
+	Free(pid);
+}
+
+//----------------------------------------------------------------------
+// ThreadTable::Lookup
+// 	Return the thread with this pid, or NULL if there is none.
+//----------------------------------------------------------------------
+
+Thread *
+ThreadTable::Lookup(int pid)
+{
+    if ((pid < 0) || (pid >= size))
+	return NULL;
+    return threads[pid];
+}
+
+//----------------------------------------------------------------------
+// ThreadTable::SetExited
+// 	Note that a thread has called Exit.  It no longer competes for
+//	the CPU, so the scheduler need not visit it.
+//----------------------------------------------------------------------
+
+void
+ThreadTable::SetExited(int pid)
+{
+    ASSERT(inUse[pid]);
+    exited[pid] = TRUE;
+    Unlink(pid);
+}
+
+//----------------------------------------------------------------------
+// ThreadTable::Completed
+// 	Record the time at which a thread finished.  Only running
+//	totals are kept, so that Halt does not need an entry for every
+//	thread that ever ran.
+//----------------------------------------------------------------------
+
+void
+ThreadTable::Completed(Thread *thread, int when)
+{
+    if (thread == first) {
+	firstCompleted = TRUE;
+	firstCompletion = when;
+	return;
+    }
+    if ((numCompleted == 0) || (when > completionMax))
+	completionMax = when;
+    if ((numCompleted == 0) || (when < completionMin))
+	completionMin = when;
+    completionSum += when;
+    completionSquares += (double)when * when;
+    numCompleted++;
+}
+
+//----------------------------------------------------------------------
+// ThreadTable::CompletionStatistics
+// 	Compute the completion time statistics printed by Halt, either
+//	over every thread or over all but the first (main) thread.
+//	"max" and "min" come in holding their starting values.
+//
+//	As before, a thread that never finished counts as completing at
+//	time -1, and the variance is always taken over the threads other
+//	than the first one.
+//----------------------------------------------------------------------
+
+void
+ThreadTable::CompletionStatistics(bool excludeFirst, int *max, int *min,
+				  float *avg, float *variance)
+{
+    int others = numCreated - 1;
+    int count = excludeFirst ? others : numCreated;
+    double total = completionSum;
+    double mean, spread;
+
+    if (numCompleted > 0) {
+	if (completionMax > *max) *max = completionMax;
+	if (completionMin < *min) *min = completionMin;
+    }
+    if (!excludeFirst && firstCompleted) {
+	total += firstCompletion;
+	if (firstCompletion > *max) *max = firstCompletion;
+	if (firstCompletion < *min) *min = firstCompletion;
+    }
+
+    mean = total / count;
+    spread = completionSquares - 2 * mean * completionSum
+		+ numCompleted * mean * mean
+		+ (others - numCompleted) * (mean + 1) * (mean + 1);
+    *avg = mean;
+    *variance = spread / count;
+}
@@ -0,0 +1,81 @@
+// threadtable.h
+//	Data structures for keeping track of every thread in the system
+//	by its process id.
+//
+//	A pid is handed out when a thread is created and recycled once
+//	nobody can ask about it any more: when the thread has been
+//	deleted and its parent has either joined with it or gone away.
+//	Until then, a deleted thread's pid stays reserved, so that a
+//	later Join cannot mistake a new thread for an old child.
+//
+//	The table grows as needed, so there is no limit on the number of
+//	threads created over the life of a simulation.  Threads that
+//	have not yet called Exit are also kept in a dense array, so that
+//	the scheduler can visit them without walking dead slots.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef THREADTABLE_H
+#define THREADTABLE_H
+
+#include "copyright.h"
+#include "thread.h"
+
+#define InitialThreadTableSize	64	// doubled whenever we run out
+
+// The following class defines the pid table.  All operations are
+// constant time, apart from the occasional doubling of the table.
+
+class ThreadTable {
+  public:
+    ThreadTable();			// initialize an empty table
+    ~ThreadTable();			// de-allocate the table
+
+    int Add(Thread *thread);		// give "thread" a pid, and return it
+    void Remove(Thread *thread);	// "thread" is being deleted
+    void Release(int pid);		// the parent of "pid" will never
+					// join with it
+    Thread *Lookup(int pid);		// the thread with this pid, or NULL
+					// if it has been deleted
+
+    void SetExited(int pid);		// "pid" has called Exit
+    bool HasExited(int pid) { return exited[pid]; }
+    bool AllExited() { return numLive == 0; }
+
+    int NumLive() { return numLive; }	// threads that have not called Exit
+    Thread *Live(int i) { return live[i]; }	// in no particular order
+
+    void Completed(Thread *thread, int when);	// record when "thread"
+						// finished, for Halt
+    void CompletionStatistics(bool excludeFirst, int *max, int *min,
+			      float *avg, float *variance);
+
+  private:
+    void Grow();			// double the size of the table
+    void Free(int pid);			// put "pid" back on the free list
+    void Unlink(int pid);		// take "pid" off the live array
+
+    int size;				// number of pids in the table
+    Thread **threads;			// the thread with each pid, NULL if
+					// the thread has been deleted
+    bool *exited;			// which pids have called Exit
+    bool *inUse;			// which pids are taken
+    int *nextFree;			// links the free pids together
+    int freeList;			// first free pid, -1 if none
+    int *liveIndex;			// where each pid is in "live", or -1
+    Thread **live;			// threads that have not called Exit
+    int numLive;
+
+    int numCreated;			// threads created, ever
+    Thread *first;			// the first thread (main), while
+					// it exists
+    bool firstCompleted;		// completion time of the first thread
+    int firstCompletion;
+    int numCompleted;			// completion times of everyone else
+    double completionSum, completionSquares;
+    int completionMax, completionMin;
+};
+
+#endif // THREADTABLE_H
@@ -67,6 +67,7 @@ AddrSpace::AddrSpace(OpenFile *executable)
 
     // Set shared pages to zero
     numSharedPages = 0;
+    ringAddr = -1;			// no syscall ring until RingSetup
 
     executable->ReadAt((char *)&noffH, sizeof(noffH), 0);
     if ((noffH.noffMagic != NOFFMAGIC) && 
@@ -177,6 +178,7 @@ AddrSpace :: AddrSpace(char* filename)
 
     // Set shared pages to zero
     numSharedPages = 0;
+    ringAddr = -1;			// no syscall ring until RingSetup
 
     executable->ReadAt((char *)&noffH, sizeof(noffH), 0);
     if ((noffH.noffMagic != NOFFMAGIC) && 
@@ -239,6 +241,7 @@ AddrSpace::AddrSpace(AddrSpace *parentSpace)
     numPages = parentSpace->GetNumPages();
     unsigned i, size = numPages * PageSize;
     numSharedPages = parentSpace->GetNumSharedPages();
+    ringAddr = parentSpace->GetRingAddr();	// ring lives in shared pages
     
     //ASSERT(numPages+numPagesAllocated-numSharedPages <= NumPhysPages);        // check we're not trying
                                                                                 // to run anything too big --
@@ -321,6 +324,7 @@ AddrSpace::AddrSpace(AddrSpace *parentSpace)
         numPages = parentSpace->GetNumPages();
     unsigned i, size = numPages * PageSize;
     numSharedPages = parentSpace->GetNumSharedPages();
+    ringAddr = parentSpace->GetRingAddr();	// ring lives in shared pages
 
     ASSERT(numPages+numPagesAllocated-numSharedPages <= NumPhysPages);        // check we're not trying
                                                                                 // to run anything too big --
@@ -460,6 +464,18 @@ AddrSpace::GetPageTable()
    return pageTable;
 }
 
+int
+AddrSpace::GetRingAddr()
+{
+   return ringAddr;
+}
+
+void
+AddrSpace::SetRingAddr(int addr)
+{
+   ringAddr = addr;
+}
+
 
 //----------------------------------------------------------------------
 // AddrSpace::AllocateSharedMem
@@ -40,12 +40,16 @@ class AddrSpace {
     
     unsigned int AllocateSharedMem(unsigned int reqMem);
 
+    int GetRingAddr();			// Virtual address of the syscall
+    void SetRingAddr(int addr);		// ring, -1 if none
+
   private:
     TranslationEntry *pageTable;	// Assume linear page table translation
 					// for now!
     unsigned int numPages;		// Number of pages in the virtual 
 					// address space
     unsigned int numSharedPages;        // Number of shared pages
+    int ringAddr;			// Syscall ring set up by RingSetup
 
  public:
     char *buffer;                       // Backup array
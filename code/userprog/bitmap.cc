@@ -102,6 +102,42 @@ BitMap::Find()
     return -1;
 }
 
+//----------------------------------------------------------------------
+// BitMap::FindRun
+// 	Find a run of consecutive clear bits and set them.  The search
+//	starts at bit "near" and wraps around, and stops at the first run
+//	of "wanted" bits.  If no run is that long, take the longest one.
+//	Used to keep the sectors of a file together on the disk.
+//
+//	Return the first bit of the run and set "*length" to the number
+//	of bits in it, or return -1 if no bits are clear.
+//----------------------------------------------------------------------
+
+int
+BitMap::FindRun(int near, int wanted, int *length)
+{
+    int best = -1, bestLength = 0;
+    int i, n, run;
+
+    ASSERT(wanted > 0);
+    for (n = 0; n < numBits; n += (run > 0) ? run : 1) {
+	i = (near + n) % numBits;
+	for (run = 0; (i + run < numBits) && (run < wanted) 
+			&& !Test(i + run); run++)
+	    ;
+	if (run > bestLength) {
+	    best = i;
+	    bestLength = run;
+	    if (run == wanted)
+		break;
+	}
+    }
+    for (n = 0; n < bestLength; n++)
+	Mark(best + n);
+    *length = bestLength;
+    return best;
+}
+
 //----------------------------------------------------------------------
 // BitMap::NumClear
 // 	Return the number of clear bits in the bitmap.
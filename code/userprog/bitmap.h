@@ -43,6 +43,11 @@ class BitMap {
     int Find();            	// Return the # of a clear bit, and as a side
 				// effect, set the bit. 
 				// If no bits are clear, return -1.
+    int FindRun(int near, int wanted, int *length);
+				// Find and set a run of up to "wanted"
+				// clear bits, preferably starting at or
+				// after "near".  Return the first bit,
+				// and the run length in "length".
     int NumClear();		// Return the number of clear bits
 
     void Print();		// Print contents of bitmap
@@ -21,11 +21,14 @@
 // All rights reserved.  See copyright.h for copyright notice and limitation 
 // of liability and disclaimer of warranty provisions.
 
+#include <stddef.h>
+
 #include "copyright.h"
 #include "system.h"
 #include "syscall.h"
 #include "console.h"
 #include "synch.h"
+#include "usercopy.h"
 
 //----------------------------------------------------------------------
 // ExceptionHandler
@@ -64,6 +67,171 @@ ForkStartFunction (int dummy)
    machine->Run();
 }
 
+//----------------------------------------------------------------------
+// DoPrintString, DoSemOp, DoSleep
+// 	Bodies of the PrintString, SemOp and Sleep system calls, shared
+//	by the trap path and the syscall ring (see DrainRing below).
+//	DoSemOp returns -1 if "semaphoreid" does not name a semaphore.
+//----------------------------------------------------------------------
+
+static void DoPrintString (int vaddr, Console *console)
+{
+   char chunk[PageSize+1];
+   int i, len;
+   bool more;
+
+   // Copy the string in a page-sized piece at a time, so a long string
+   // does not need a long kernel buffer.
+   do {
+      len = CopyInString(vaddr, chunk, sizeof(chunk));
+      more = (len == StringTooLong);
+      if (more) len = PageSize;
+      for (i = 0; i < len; i++) {
+         writeDone->P() ;
+         console->PutChar(chunk[i]);
+      }
+      vaddr += len;
+   } while (more);
+}
+
+static int DoSemOp (int semaphoreid, int adjust)
+{
+   if ((semaphoreid < 0) || (semaphoreid >= 100)
+       || (semaphoreKeyIndexMap[semaphoreid] == -1)) return -1;
+   if (adjust == -1) semaphoreMap[semaphoreid]->P();
+   else semaphoreMap[semaphoreid]->V();
+   return 0;
+}
+
+static void DoSleep (unsigned sleeptime)
+{
+   if (sleeptime == 0) {
+      // emulate a yield
+      currentThread->Yield();
+   }
+   else {
+      currentThread->SortedInsertInWaitQueue (sleeptime+stats->totalTicks);
+   }
+}
+
+//----------------------------------------------------------------------
+// ReadUserWord, WriteUserWord
+// 	Access a word of the syscall ring, which the kernel allocated and
+//	so always translates.
+//----------------------------------------------------------------------
+
+static int ReadUserWord (int vaddr)
+{
+   int word;
+
+   CopyInFromUser(vaddr, (char *)&word, sizeof(int));
+   return WordToHost(word);
+}
+
+static void WriteUserWord (int vaddr, int value)
+{
+   int word = WordToMachine(value);
+
+   CopyOutToUser(vaddr, (char *)&word, sizeof(int));
+}
+
+//----------------------------------------------------------------------
+// SetupRing
+// 	Map a zeroed IoRing into the current address space, or return
+//	the one already mapped.
+//----------------------------------------------------------------------
+
+static int SetupRing ()
+{
+   AddrSpace *space = currentThread->space;
+   IoRing empty;
+
+   if (space->GetRingAddr() == -1) {
+      int addr = space->AllocateSharedMem(sizeof(IoRing));
+      bzero(&empty, sizeof(IoRing));
+      CopyOutToUser(addr, (char *)&empty, sizeof(IoRing));
+      space->SetRingAddr(addr);
+   }
+   return space->GetRingAddr();
+}
+
+//----------------------------------------------------------------------
+// DrainRing
+// 	Execute every request queued on the submission ring of the
+//	current address space, posting a completion for each.  This lets
+//	a user program pay for one trap instead of one per request.
+//	Stops early if the completion ring fills up.  Returns the number
+//	of requests consumed, or -1 if RingSetup has not been called.
+//----------------------------------------------------------------------
+
+#define RING_FIELD(ring, field)	((ring) + (int)offsetof(IoRing, field))
+
+static int DrainRing (Console *console)
+{
+   int ring = currentThread->space->GetRingAddr();
+   unsigned sqHead, sqTail, cqHead, cqTail;
+   RingSubmission req;
+   RingCompletion done;
+   int opcode, arg1, arg2, result;
+   int consumed = 0;
+
+   if (ring == -1) return -1;
+
+   sqHead = ReadUserWord(RING_FIELD(ring, sqHead));
+   sqTail = ReadUserWord(RING_FIELD(ring, sqTail));
+   while (sqHead != sqTail) {
+      // Re-read the consumer index each time, since a request may block
+      // while a forked child sharing the ring reaps completions.
+      cqHead = ReadUserWord(RING_FIELD(ring, cqHead));
+      cqTail = ReadUserWord(RING_FIELD(ring, cqTail));
+      if (cqTail - cqHead >= RING_SIZE) break;
+
+      CopyInFromUser(RING_FIELD(ring, sq) + (sqHead % RING_SIZE)*sizeof(RingSubmission),
+                     (char *)&req, sizeof(RingSubmission));
+      opcode = WordToHost(req.opcode);
+      arg1 = WordToHost(req.arg1);
+      arg2 = WordToHost(req.arg2);
+      // Consume the entry before running it, so the slot can be reused
+      // while a blocking request is in progress.
+      sqHead++;
+      WriteUserWord(RING_FIELD(ring, sqHead), sqHead);
+
+      DEBUG('a', "Ring request %d (%d, %d)\n", opcode, arg1, arg2);
+      result = 0;
+      switch (opcode) {
+         case RING_OP_NOP:
+            break;
+         case RING_OP_PRINTCHAR:
+            writeDone->P() ;
+            console->PutChar(arg1);
+            break;
+         case RING_OP_PRINTSTRING:
+            DoPrintString(arg1, console);
+            break;
+         case RING_OP_SEMOP:
+            result = DoSemOp(arg1, arg2);
+            break;
+         case RING_OP_SLEEP:
+            DoSleep((unsigned)arg1);
+            break;
+         default:
+            result = -1;
+            break;
+      }
+
+      done.userData = req.userData;		// already in machine order
+      done.result = WordToMachine(result);
+      cqTail = ReadUserWord(RING_FIELD(ring, cqTail));
+      CopyOutToUser(RING_FIELD(ring, cq) + (cqTail % RING_SIZE)*sizeof(RingCompletion),
+                    (char *)&done, sizeof(RingCompletion));
+      WriteUserWord(RING_FIELD(ring, cqTail), cqTail+1);
+      consumed++;
+
+      sqTail = ReadUserWord(RING_FIELD(ring, sqTail));
+   }
+   return consumed;
+}
+
 static void ConvertIntToHex (unsigned v, Console *console)
 {
    unsigned x;
@@ -84,7 +252,7 @@ void
 ExceptionHandler(ExceptionType which)
 {
     int type = machine->ReadRegister(2);
-    int memval, vaddr, printval, tempval, exp;
+    int vaddr, printval, tempval, exp;
     unsigned printvalus;	// Used for printing in hex
     if (!initializedConsoleSemaphores) {
        readAvail = new Semaphore("read avail", 0);
@@ -95,6 +263,7 @@ ExceptionHandler(ExceptionType which)
     int exitcode;		// Used in SC_Exit
     unsigned i;
     char buffer[1024];		// Used in SC_Exec
+    int namelen;		// Used in SC_Exec
     int waitpid;		// Used in SC_Join
     int whichChild;		// Used in SC_Join
     Thread *child;		// Used by SC_Fork
@@ -110,7 +279,7 @@ ExceptionHandler(ExceptionType which)
        // We do not wait for the children to finish.
        // The children will continue to run.
        // We will worry about this when and if we implement signals.
-       exitThreadArray[currentThread->GetPID()] = true;
+       threadTable->SetExited(currentThread->GetPID());
        AddrSpace *temp = currentThread->space;
        TranslationEntry* pageTable = temp->GetPageTable();
        
@@ -122,24 +291,21 @@ ExceptionHandler(ExceptionType which)
                }
 
        // Find out if all threads have called exit
-       for (i=0; i<thread_index; i++) {
-          if (!exitThreadArray[i]) break;
-       }
-       currentThread->Exit(i==thread_index, exitcode);
+       currentThread->Exit(threadTable->AllExited(), exitcode);
     }
     else if ((which == SyscallException) && (type == SC_Exec)) {
        // Copy the executable name into kernel space
        vaddr = machine->ReadRegister(4);
-       machine->ReadMem(vaddr, 1, &memval);
-       i = 0;
-       while ((*(char*)&memval) != '\0') {
-          buffer[i] = (*(char*)&memval);
-          i++;
-          vaddr++;
-          machine->ReadMem(vaddr, 1, &memval);
+       namelen = CopyInString(vaddr, buffer, sizeof(buffer));
+       if ((namelen == -1) || (namelen == StringTooLong)) {
+          printf("[pid %d] Exec: bad executable name.\n", currentThread->GetPID());
+          machine->WriteRegister(2, -1);
+          // Advance program counters.
+          machine->WriteRegister(PrevPCReg, machine->ReadRegister(PCReg));
+          machine->WriteRegister(PCReg, machine->ReadRegister(NextPCReg));
+          machine->WriteRegister(NextPCReg, machine->ReadRegister(NextPCReg)+4);
        }
-       buffer[i] = (*(char*)&memval);
-       StartProcess(buffer);
+       else StartProcess(buffer);
     }
     else if ((which == SyscallException) && (type == SC_Join)) {
        waitpid = machine->ReadRegister(4);
@@ -223,14 +389,7 @@ ExceptionHandler(ExceptionType which)
         machine->WriteRegister(NextPCReg, machine->ReadRegister(NextPCReg)+4);
     }
     else if ((which == SyscallException) && (type == SC_PrintString)) {
-       vaddr = machine->ReadRegister(4);
-       machine->ReadMem(vaddr, 1, &memval);
-       while ((*(char*)&memval) != '\0') {
-          writeDone->P() ;
-          console->PutChar(*(char*)&memval);
-          vaddr++;
-          machine->ReadMem(vaddr, 1, &memval);
-       }
+       DoPrintString(machine->ReadRegister(4), console);
        // Advance program counters.
        machine->WriteRegister(PrevPCReg, machine->ReadRegister(PCReg));
        machine->WriteRegister(PCReg, machine->ReadRegister(NextPCReg));
@@ -267,13 +426,7 @@ ExceptionHandler(ExceptionType which)
     }
     else if ((which == SyscallException) && (type == SC_Sleep)) {
        sleeptime = machine->ReadRegister(4);
-       if (sleeptime == 0) {
-          // emulate a yield
-          currentThread->Yield();
-       }
-       else {
-          currentThread->SortedInsertInWaitQueue (sleeptime+stats->totalTicks);
-       }
+       DoSleep(sleeptime);
        // Advance program counters.
        machine->WriteRegister(PrevPCReg, machine->ReadRegister(PCReg));
        machine->WriteRegister(PCReg, machine->ReadRegister(NextPCReg));
@@ -304,6 +457,20 @@ ExceptionHandler(ExceptionType which)
        machine->WriteRegister(PCReg, machine->ReadRegister(NextPCReg));
        machine->WriteRegister(NextPCReg, machine->ReadRegister(NextPCReg)+4);
     }
+    else if ((which == SyscallException) && (type == SC_RingSetup)) {
+       machine->WriteRegister(2, SetupRing());
+       // Advance program counters.
+       machine->WriteRegister(PrevPCReg, machine->ReadRegister(PCReg));
+       machine->WriteRegister(PCReg, machine->ReadRegister(NextPCReg));
+       machine->WriteRegister(NextPCReg, machine->ReadRegister(NextPCReg)+4);
+    }
+    else if ((which == SyscallException) && (type == SC_RingEnter)) {
+       machine->WriteRegister(2, DrainRing(console));
+       // Advance program counters.
+       machine->WriteRegister(PrevPCReg, machine->ReadRegister(PCReg));
+       machine->WriteRegister(PCReg, machine->ReadRegister(NextPCReg));
+       machine->WriteRegister(NextPCReg, machine->ReadRegister(NextPCReg)+4);
+    }
     else if((which == SyscallException) && (type == SC_ShmAllocate)) 
       {
 	unsigned reqMem = machine->ReadRegister(4); // Bytes
@@ -352,12 +519,7 @@ ExceptionHandler(ExceptionType which)
        int newValue = machine->ReadRegister(5);
         DEBUG('h',"c1 %d %d\n",semaphoreid,newValue);
        
-       if(newValue==-1){
-        semaphoreMap[semaphoreid]->P();
-       }
-       else{
-        semaphoreMap[semaphoreid]->V();
-      }
+       DoSemOp(semaphoreid, newValue);
         DEBUG('h',"c2\n");
        // Advance program counters.
        machine->WriteRegister(PrevPCReg, machine->ReadRegister(PCReg));
@@ -385,15 +547,16 @@ ExceptionHandler(ExceptionType which)
 //        printf("ankhee: %d\n",machine->mainMemory[paddr]);
         //machine->mainMemory[paddr]=semaphoreMap[semaphoreid]->getValue();
         //printf("ankhee: %d\n",machine->mainMemory[paddr]);
-        machine->WriteMem(addr,sizeof(int),semaphoreMap[semaphoreid]->getValue());
+        int semValue = WordToMachine(semaphoreMap[semaphoreid]->getValue());
+        CopyOutToUser(addr, (char *)&semValue, sizeof(int));
 
        machine->WriteRegister(2, 0);  // Return value
        }
        else if(command == SYNCH_SET){
         DEBUG('h',"mem\n");
             int semValue;
-            machine->ReadMem(addr, sizeof(int), &semValue);
-            semaphoreMap[semaphoreid]->setValue(semValue);
+            CopyInFromUser(addr, (char *)&semValue, sizeof(int));
+            semaphoreMap[semaphoreid]->setValue(WordToHost(semValue));
             //machine->WriteMem(addr,sizeof(int),semaphoreMap[semaphoreid]->getValue());
             //printf("irfan: %d\n",machine->mainMemory[paddr]);
        machine->WriteRegister(2, 0);  // Return value
@@ -89,6 +89,7 @@ ConsoleTest (char *in, char *out)
     writeDone = new Semaphore("write done", 0);
     
     for (;;) {
+	console->ExpectChar();
 	readAvail->P();		// wait for character to arrive
 	ch = console->GetChar();
 	console->PutChar(ch);	// echo it!
@@ -98,24 +99,22 @@ ConsoleTest (char *in, char *out)
 }
 
 //--------------------------------------------------------------------------------------------------
-// ReadInputAndFork (multiprogramming test)
-//	Read the scheduling algorithm.
-//      Read a set of user programs along with the priorities.  Open the executables, load them into
-//      memory, and invoke the scheduler.
+// ReadBatchFile
+//	Read the scheduling algorithm and the set of user programs along with their priorities
+//	from a batch file into batchProcesses and priority.  Returns the number of programs
+//	read, or -1 if the file cannot be opened.
 //---------------------------------------------------------------------------------------------------
 
-void
-ReadInputAndFork (char *filename)
+static int
+ReadBatchFile (char *filename)
 {
    OpenFile *inFile = fileSystem->Open(filename);
-   char c, buffer[16];
-   unsigned batchSize=0, bytesRead, charPointer, i;
- 
-   excludeMainThread = TRUE;
-  
+   char c;
+   unsigned batchSize=0, bytesRead, charPointer;
+
    if (inFile == NULL) {
       printf("Unable to open file %s\n", filename);
-      return;
+      return -1;
    }
 
    inFile->Read(&c, 1);
@@ -129,7 +128,7 @@ ReadInputAndFork (char *filename)
    //printf("%d\n", schedulingAlgo);
 
    if ((schedulingAlgo == ROUND_ROBIN) || (schedulingAlgo == UNIX_SCHED)) {
-      ASSERT (SCHED_QUANTUM > 0);
+      ASSERT (schedQuantum > 0);
    }
 
    bytesRead = inFile->Read(&c, 1);
@@ -157,6 +156,21 @@ ReadInputAndFork (char *filename)
       bytesRead = inFile->Read(&c, 1);
    }
    delete inFile;
+   return batchSize;
+}
+
+//--------------------------------------------------------------------------------------------------
+// StartBatch
+//      Open the first batchSize executables in batchProcesses, load them into memory, and
+//      invoke the scheduler.  The calling thread exits.
+//---------------------------------------------------------------------------------------------------
+
+static void
+StartBatch (unsigned batchSize)
+{
+   OpenFile *inFile;
+   char buffer[16];
+   unsigned i;
 
    for (i=0; i<batchSize; i++) {
       // Create one child per iteration
@@ -167,7 +181,10 @@ ReadInputAndFork (char *filename)
       }
       sprintf(buffer,"Thread_%d",i+1);
       Thread *child = new Thread(buffer, priority[i]);
-      child->space = new AddrSpace (inFile);
+      if (replaceAlgo == -1)
+         child->space = new AddrSpace (inFile);
+      else
+         child->space = new AddrSpace (batchProcesses[i]);   // demand paged
       delete inFile;
       child->space->InitRegisters();             // set the initial register values
       child->SaveUserState ();
@@ -179,11 +196,335 @@ ReadInputAndFork (char *filename)
    // Cleanly exit current thread
    // Assume exit code zero
    printf("[pid %d]: Exit called. Code: %d\n", currentThread->GetPID(), 0);
-   exitThreadArray[currentThread->GetPID()] = true;
+   threadTable->SetExited(currentThread->GetPID());
 
    // Find out if all threads have called exit
-   for (i=0; i<thread_index; i++) {
-       if (!exitThreadArray[i]) break;
+   currentThread->Exit(threadTable->AllExited(), 0);
+}
+
+//--------------------------------------------------------------------------------------------------
+// ReadInputAndFork (multiprogramming test)
+//	Read the scheduling algorithm.
+//      Read a set of user programs along with the priorities.  Open the executables, load them into
+//      memory, and invoke the scheduler.
+//---------------------------------------------------------------------------------------------------
+
+void
+ReadInputAndFork (char *filename)
+{
+   int batchSize;
+
+   excludeMainThread = TRUE;
+
+   batchSize = ReadBatchFile(filename);
+   if (batchSize < 0) return;
+   StartBatch(batchSize);
+}
+
+// Summary of one simulation instance, sent from the instance to the
+// parent over a pipe when the instance halts (see ReportBatchInstance).
+
+typedef struct {
+   int instance;		// Which instance this is
+   int batchSize;		// Number of programs it ran
+   int totalTicks;		// Simulated time to complete its share
+   int idleTicks;
+   int userTicks;
+   int cpuTime;			// Total CPU busy time
+   int waitTime;		// Total wait time in ready queue
+   int numThreads;		// Total number of created threads
+   int contextSwitches;		// Preemptive plus non-preemptive
+   int pageFaults;
+   int maxCompletion;
+   float avgCompletion;
+   float burstError;		// SJF burst estimate error per tick of CPU
+} BatchReport;
+
+static int batchInstance;	// Which instance this process simulates
+static int batchInstanceSize;	// Number of programs given to it
+
+//--------------------------------------------------------------------------------------------------
+// ReportBatchInstance
+//	Called by Interrupt::Halt in an instance started by ReadInputAndForkParallel, to send its
+//	statistics to the parent process.
+//---------------------------------------------------------------------------------------------------
+
+void
+ReportBatchInstance (int maxCompletion, float avgCompletion)
+{
+   BatchReport report;
+
+   report.instance = batchInstance;
+   report.batchSize = batchInstanceSize;
+   report.totalTicks = stats->totalTicks;
+   report.idleTicks = stats->idleTicks;
+   report.userTicks = stats->userTicks;
+   report.cpuTime = stats->cpu_time;
+   report.waitTime = stats->total_wait_time;
+   report.numThreads = stats->numTotalThreads;
+   report.contextSwitches = stats->preemptive_switch + stats->nonpreemptive_switch;
+   report.pageFaults = numPageFaults;
+   report.maxCompletion = maxCompletion;
+   report.avgCompletion = avgCompletion;
+   report.burstError = stats->cpu_time ? (float)stats->burstEstimateError/stats->cpu_time : 0.0;
+
+   // Smaller than PIPE_BUF, so the write is atomic even though
+   // several instances share the pipe.
+   WriteFile(batchReportFd, (char *)&report, sizeof(BatchReport));
+   Close(batchReportFd);
+   batchReportFd = -1;
+}
+
+//--------------------------------------------------------------------------------------------------
+// ReadInputAndForkParallel
+//	Like ReadInputAndFork, but split the batch round robin over "instances" independent
+//      simulations, each in its own host process with its own Machine, Interrupt, Scheduler and
+//      Statistics, so that large batches use more than one host CPU.  Every instance uses the
+//      scheduling algorithm of the batch file.  Prints the statistics of each instance and the
+//      aggregate once all have halted.
+//---------------------------------------------------------------------------------------------------
+
+void
+ReadInputAndForkParallel (char *filename, int instances)
+{
+   int batchSize, i, j, n, fds[2], failed = 0;
+   BatchReport report;
+   int reports = 0, programs = 0, makespan = 0, cpuTime = 0, waitTime = 0, numThreads = 0;
+   int contextSwitches = 0, pageFaults = 0, maxCompletion = 0;
+   float completionSum = 0;
+
+   excludeMainThread = TRUE;
+
+   batchSize = ReadBatchFile(filename);
+   if (batchSize < 0) return;
+   ASSERT(instances > 0);
+   if (instances > batchSize) instances = batchSize;
+
+   OpenPipe(fds);
+   for (i=0; i<instances; i++) {
+      if (StartChildProcess() == 0) {
+         // Keep every instances'th program, starting at i
+         Close(fds[0]);
+         batchReportFd = fds[1];
+         batchInstance = i;
+         for (j=i, n=0; j<batchSize; j+=instances, n++) {
+            strcpy(batchProcesses[n], batchProcesses[j]);
+            priority[n] = priority[j];
+         }
+         batchInstanceSize = n;
+         StartBatch(n);
+         ASSERT(FALSE);		// the instance halts from Interrupt::Halt
+      }
+   }
+   Close(fds[1]);
+
+   // Collect one report per instance; the read fails once every
+   // instance has closed its end of the pipe.
+   while ((n = ReadPartial(fds[0], (char *)&report, sizeof(BatchReport))) > 0) {
+      ASSERT(n == sizeof(BatchReport));
+      printf("Instance %d: programs %d, ticks %d (idle %d, user %d), CPU busy %d, wait %d, "
+             "switches %d, page faults %d, completion max %d avg %.2f\n",
+             report.instance, report.batchSize, report.totalTicks, report.idleTicks,
+             report.userTicks, report.cpuTime, report.waitTime, report.contextSwitches,
+             report.pageFaults, report.maxCompletion, report.avgCompletion);
+      reports++;
+      programs += report.batchSize;
+      if (report.totalTicks > makespan) makespan = report.totalTicks;
+      cpuTime += report.cpuTime;
+      waitTime += report.waitTime;
+      numThreads += report.numThreads;
+      contextSwitches += report.contextSwitches;
+      pageFaults += report.pageFaults;
+      if (report.maxCompletion > maxCompletion) maxCompletion = report.maxCompletion;
+      completionSum += report.avgCompletion*report.batchSize;
+   }
+   Close(fds[0]);
+   for (i=0; i<instances; i++) {
+      if (WaitForChildProcess() != 0) failed++;
+   }
+
+   printf("\nAggregate over %d instances (%d reported, %d failed): programs %d, makespan %d ticks, "
+          "throughput %.4f programs per 1000 ticks\n", instances, reports, failed, programs, makespan,
+          makespan ? 1000.0*programs/makespan : 0.0);
+   printf("CPU busy %d, wait time total %d average %.2f, context switches %d, page faults %d\n",
+          cpuTime, waitTime, numThreads ? (float)waitTime/numThreads : 0.0, contextSwitches,
+          pageFaults);
+   printf("Completion time: max %d, avg %.2f\n", maxCompletion,
+          programs ? completionSum/programs : 0.0);
+   Cleanup();		// Never returns.
+}
+
+// One point of a parameter sweep (see SweepBatch)
+
+typedef struct {
+   int algo;
+   int quantum;
+   float alpha;
+   int policy;			// page replacement algorithm, 0 for none
+} SweepRun;
+
+#define MAX_SWEEP_RUNS		256
+#define MAX_SWEEP_VALUES	16
+#define SWEEP_POLL_INTERVAL	10	// ms between checks for a finished run
+
+//--------------------------------------------------------------------------------------------------
+// ParseList
+//	Parse a comma separated list of numbers, such as "1,2,4" or "0.25,0.5", into "values".
+//      Returns how many were read.
+//---------------------------------------------------------------------------------------------------
+
+static int
+ParseList (char *list, float *values)
+{
+   int n = 0;
+   char *p = list;
+
+   while (*p != '\0') {
+      ASSERT(n < MAX_SWEEP_VALUES);
+      values[n++] = atof(p);
+      while ((*p != ',') && (*p != '\0')) p++;
+      if (*p == ',') p++;
+   }
+   ASSERT(n > 0);
+   return n;
+}
+
+//--------------------------------------------------------------------------------------------------
+// ReadSweepReport
+//	Read one run's report from the pipe into "reports".  Returns FALSE at end of file, once
+//      every run has closed its end of the pipe.
+//---------------------------------------------------------------------------------------------------
+
+static bool
+ReadSweepReport (int fd, BatchReport *reports, bool *reported)
+{
+   BatchReport report;
+   int n = ReadPartial(fd, (char *)&report, sizeof(BatchReport));
+
+   if (n <= 0) return FALSE;
+   ASSERT(n == sizeof(BatchReport));
+   reports[report.instance] = report;
+   reported[report.instance] = TRUE;
+   return TRUE;
+}
+
+//--------------------------------------------------------------------------------------------------
+// ReapSweepRun
+//	Wait for a run to finish and return its exit code.  Reports are read off the pipe in the
+//      meantime; otherwise a run could block writing to a full pipe while we wait for it.
+//---------------------------------------------------------------------------------------------------
+
+static int
+ReapSweepRun (int fd, BatchReport *reports, bool *reported)
+{
+   int code;
+   bool ready;
+
+   while (!PollChildProcess(&code)) {
+      if (WaitForFiles(&fd, &ready, 1, SWEEP_POLL_INTERVAL)
+          && !ReadSweepReport(fd, reports, reported))
+         return WaitForChildProcess();	// nobody left to write
+   }
+   return code;
+}
+
+//--------------------------------------------------------------------------------------------------
+// SweepBatch
+//	Run the batch in "filename" once for every combination of the scheduling algorithms,
+//      quanta, SJF alpha values and page replacement policies in the given comma separated
+//      lists, overriding the algorithm named in the batch file.  Quanta only vary for the
+//      preemptive algorithms and alpha only for SJF, so no run is repeated needlessly.
+//      Each run is an independent simulation in its own host process, and up to "jobs" of
+//      them run at a time.  Prints one CSV row per run once all have finished.
+//---------------------------------------------------------------------------------------------------
+
+void
+SweepBatch (char *filename, char *algos, char *quanta, char *alphas, char *policies, int jobs)
+{
+   float algoList[MAX_SWEEP_VALUES], quantumList[MAX_SWEEP_VALUES];
+   float alphaList[MAX_SWEEP_VALUES], policyList[MAX_SWEEP_VALUES];
+   int numAlgos, numQuanta, numAlphas, numPolicies;
+   SweepRun runs[MAX_SWEEP_RUNS];
+   BatchReport reports[MAX_SWEEP_RUNS], report;
+   bool reported[MAX_SWEEP_RUNS];
+   int batchSize, numRuns = 0, active = 0, failed = 0, fds[2], a, q, al, p, r;
+
+   excludeMainThread = TRUE;
+
+   batchSize = ReadBatchFile(filename);
+   if (batchSize < 0) return;
+
+   numAlgos = ParseList(algos, algoList);
+   numQuanta = ParseList(quanta, quantumList);
+   numAlphas = ParseList(alphas, alphaList);
+   numPolicies = ParseList(policies, policyList);
+   for (a=0; a<numAlgos; a++) {
+      for (q=0; q<numQuanta; q++) {
+         for (al=0; al<numAlphas; al++) {
+            for (p=0; p<numPolicies; p++) {
+               if ((q > 0) && ((int)algoList[a] != ROUND_ROBIN) && ((int)algoList[a] != UNIX_SCHED))
+                  continue;
+               if ((al > 0) && ((int)algoList[a] != NON_PREEMPTIVE_SJF))
+                  continue;
+               ASSERT(numRuns < MAX_SWEEP_RUNS);
+               runs[numRuns].algo = (int)algoList[a];
+               runs[numRuns].quantum = (int)quantumList[q];
+               runs[numRuns].alpha = alphaList[al];
+               runs[numRuns].policy = (int)policyList[p];
+               ASSERT((runs[numRuns].algo > 0) && (runs[numRuns].algo <= 4));
+               ASSERT(runs[numRuns].quantum > 0);
+               ASSERT((runs[numRuns].policy >= 0) && (runs[numRuns].policy < 5));
+               reported[numRuns] = FALSE;
+               numRuns++;
+            }
+         }
+      }
+   }
+
+   OpenPipe(fds);
+   for (r=0; r<numRuns; r++) {
+      if (active == jobs) {
+         if (ReapSweepRun(fds[0], reports, reported) != 0) failed++;
+         active--;
+      }
+      if (StartChildProcess() == 0) {
+         Close(fds[0]);
+         DiscardOutput();
+         batchReportFd = fds[1];
+         batchInstance = r;
+         batchInstanceSize = batchSize;
+         schedulingAlgo = runs[r].algo;
+         schedQuantum = runs[r].quantum;
+         sjfAlpha = runs[r].alpha;
+         replaceAlgo = runs[r].policy ? runs[r].policy : -1;
+         StartBatch(batchSize);
+         ASSERT(FALSE);		// the run halts from Interrupt::Halt
+      }
+      active++;
+   }
+   Close(fds[1]);
+   for (; active > 0; active--) {
+      if (ReapSweepRun(fds[0], reports, reported) != 0) failed++;
+   }
+   while (ReadSweepReport(fds[0], reports, reported))
+      ;
+   Close(fds[0]);
+
+   printf("algo,quantum,alpha,policy,programs,ticks,throughput,avg_wait,burst_error,"
+          "page_faults,switches,avg_completion\n");
+   for (r=0; r<numRuns; r++) {
+      printf("%d,%d,%.3f,%d,", runs[r].algo, runs[r].quantum, runs[r].alpha, runs[r].policy);
+      if (!reported[r]) {
+         printf("failed\n");
+         continue;
+      }
+      report = reports[r];
+      printf("%d,%d,%.4f,%.2f,%.4f,%d,%d,%.2f\n", report.batchSize, report.totalTicks,
+             report.totalTicks ? 1000.0*report.batchSize/report.totalTicks : 0.0,
+             report.numThreads ? (float)report.waitTime/report.numThreads : 0.0,
+             report.burstError, report.pageFaults, report.contextSwitches,
+             report.avgCompletion);
    }
-   currentThread->Exit(i==thread_index, 0);
+   printf("%d runs, %d failed\n", numRuns, failed);
+   Cleanup();		// Never returns.
 }
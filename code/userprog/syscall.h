@@ -57,6 +57,21 @@
 
 #define SC_ShmAllocate	27
 
+#define SC_RingSetup	28
+#define SC_RingEnter	29
+
+/* Operations that can be queued on the submission ring set up by
+ * RingSetup.  Each is executed by the kernel exactly as the system
+ * call of the same name would be.
+ */
+#define RING_OP_NOP		0
+#define RING_OP_PRINTCHAR	1	/* arg1 = character */
+#define RING_OP_PRINTSTRING	2	/* arg1 = address of string */
+#define RING_OP_SEMOP		3	/* arg1 = semid, arg2 = adjust */
+#define RING_OP_SLEEP		4	/* arg1 = ticks */
+
+#define RING_SIZE		16	/* entries in each ring */
+
 #ifndef IN_ASM
 
 /* The system call interface.  These are the operations the Nachos
@@ -185,6 +200,41 @@ void CondOp (int condid, unsigned op, int semid);
 int CondRemove (int condid);
 
 unsigned ShmAllocate (unsigned size);
+
+/* Batched system calls.  RingSetup maps an IoRing into the address space
+ * of the caller (the same ring is returned if called again).  The user
+ * program queues requests at sq[sqTail % RING_SIZE] and advances sqTail;
+ * RingEnter makes the kernel execute all queued requests in one trap,
+ * posting one completion per request at cq[cqTail % RING_SIZE].  The
+ * user program consumes completions by advancing cqHead.  RingEnter
+ * returns the number of requests consumed; it stops early if the
+ * completion ring is full.
+ */
+
+typedef struct {
+   int opcode;		/* RING_OP_* */
+   int arg1;
+   int arg2;
+   int userData;	/* copied unchanged into the completion */
+} RingSubmission;
+
+typedef struct {
+   int userData;
+   int result;		/* -1 if the request was malformed */
+} RingCompletion;
+
+typedef struct {
+   unsigned sqHead;	/* advanced by the kernel */
+   unsigned sqTail;	/* advanced by the user program */
+   unsigned cqHead;	/* advanced by the user program */
+   unsigned cqTail;	/* advanced by the kernel */
+   RingSubmission sq[RING_SIZE];
+   RingCompletion cq[RING_SIZE];
+} IoRing;
+
+IoRing *RingSetup (void);
+
+int RingEnter (void);
 #endif /* IN_ASM */
 
 #endif /* SYSCALL_H */
@@ -0,0 +1,119 @@
+// usercopy.cc 
+//	Routines to move data between the kernel and the virtual address
+//	space of the current user program, a page at a time.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "usercopy.h"
+
+//----------------------------------------------------------------------
+// UserPage
+// 	Translate "vaddr" for the current user program, servicing a page
+//	fault if needed, and return where it lives in main memory.  Marks
+//	the frame as recently used for the page replacement algorithms,
+//	like Machine::ReadMem does.  Returns NULL if the address is bad.
+//
+//	The pointer is only good until the next page fault, since the
+//	fault handler may evict the page; callers must copy out of it
+//	before translating another page.
+//----------------------------------------------------------------------
+
+static char *
+UserPage(int vaddr, bool writing)
+{
+    ExceptionType exception;
+    int physAddr;
+
+    exception = machine->Translate(vaddr, &physAddr, 1, writing);
+    if (exception == PageFaultException) {
+	machine->RaiseException(exception, vaddr);
+	exception = machine->Translate(vaddr, &physAddr, 1, writing);
+    }
+    if (exception != NoException) {
+	DEBUG('a', "Bad user address 0x%x\n", vaddr);
+	return NULL;
+    }
+    pageMap[physAddr/PageSize].lastUsed = stats->totalTicks;
+    pageMap[physAddr/PageSize].secondChance = true;
+    return &machine->mainMemory[physAddr];
+}
+
+//----------------------------------------------------------------------
+// CopyInFromUser, CopyOutToUser
+// 	Copy a range of bytes into or out of user memory.  The range is
+//	split at page boundaries and each piece is translated once.
+//----------------------------------------------------------------------
+
+bool
+CopyInFromUser(int vaddr, char *buf, int size)
+{
+    char *from;
+    int chunk;
+
+    while (size > 0) {
+	chunk = min(size, PageSize - (int)((unsigned)vaddr % PageSize));
+	if ((from = UserPage(vaddr, FALSE)) == NULL)
+	    return FALSE;
+	memcpy(buf, from, chunk);
+	vaddr += chunk;
+	buf += chunk;
+	size -= chunk;
+    }
+    return TRUE;
+}
+
+bool
+CopyOutToUser(int vaddr, char *buf, int size)
+{
+    char *to;
+    int chunk;
+
+    while (size > 0) {
+	chunk = min(size, PageSize - (int)((unsigned)vaddr % PageSize));
+	if ((to = UserPage(vaddr, TRUE)) == NULL)
+	    return FALSE;
+	memcpy(to, buf, chunk);
+	vaddr += chunk;
+	buf += chunk;
+	size -= chunk;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// CopyInString
+// 	Copy a null terminated user string, one page at a time, stopping
+//	at the terminator or when "buf" is full.  A string of exactly
+//	maxSize-1 characters fits, so we look as far as the byte after
+//	them for the terminator before deciding it is too long.
+//----------------------------------------------------------------------
+
+int
+CopyInString(int vaddr, char *buf, int maxSize)
+{
+    char *from, *end;
+    int chunk, len = 0;
+
+    ASSERT(maxSize > 0);
+    while (len < maxSize) {
+	chunk = min(maxSize - len, PageSize - (int)((unsigned)vaddr % PageSize));
+	if ((from = UserPage(vaddr, FALSE)) == NULL)
+	    return -1;
+	end = (char *) memchr(from, '\0', chunk);
+	if (end != NULL) {
+	    memcpy(buf + len, from, end - from);
+	    len += end - from;
+	    buf[len] = '\0';
+	    return len;
+	}
+	memcpy(buf + len, from, chunk);
+	vaddr += chunk;
+	len += chunk;
+    }
+    buf[maxSize - 1] = '\0';		// no terminator in sight
+    return StringTooLong;
+}
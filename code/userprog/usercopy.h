@@ -0,0 +1,38 @@
+// usercopy.h 
+//	Routines to move data between the kernel and the virtual address
+//	space of the current user program.
+//
+//	Machine::ReadMem and Machine::WriteMem translate (and update the
+//	page replacement state) once per byte, word or half word.  These
+//	routines instead translate once per page and copy each page
+//	contiguous piece with a single memcpy, so moving N bytes costs
+//	O(N/PageSize) translations.  Page faults are serviced one page at
+//	a time as the copy reaches each page.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#ifndef USERCOPY_H
+#define USERCOPY_H
+
+#include "copyright.h"
+#include "utility.h"
+
+// Copy "size" bytes from user address "vaddr" into "buf".  Returns
+// FALSE if some page of the range could not be translated.
+extern bool CopyInFromUser(int vaddr, char *buf, int size);
+
+// Copy "size" bytes from "buf" to user address "vaddr".  Returns
+// FALSE if some page of the range could not be translated.
+extern bool CopyOutToUser(int vaddr, char *buf, int size);
+
+// Copy the null terminated string at user address "vaddr" into "buf",
+// copying at most maxSize-1 characters.  "buf" is always null
+// terminated.  Returns the length of the string, -1 on a bad address,
+// or StringTooLong if it did not fit; then "buf" holds its first
+// maxSize-1 characters.
+#define StringTooLong	-2
+extern int CopyInString(int vaddr, char *buf, int maxSize);
+
+#endif // USERCOPY_H